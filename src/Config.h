@@ -2,3 +2,15 @@
 
 
 #define GUI_WIDTH 240
+
+#define FFMPEG_PATH "ffmpeg"
+#define FFPROBE_PATH "ffprobe"
+
+#define GLSLANG_PATH "glslangValidator"
+#define SPIRV_OPT_PATH "spirv-opt"
+#define SPIRV_CROSS_PATH "spirv-cross"
+
+#define RENDER_SERVER_PORT 8800
+
+// counts heap allocations on the frame path, see Utils/Allocations.h
+//#define TRACK_ALLOCATIONS
@@ -0,0 +1,1420 @@
+#pragma once
+
+#include <regex>
+#include <future>
+#include <functional>
+#include "ofMain.h"
+
+#include "Hash.h"
+#include "VideoSource.h"
+#include "TextureAsset.h"
+#include "AudioSource.h"
+#include "DataSource.h"
+#include "ShaderCost.h"
+#include "ShaderOptimizer.h"
+#include "ShaderSpecializer.h"
+#include "ShaderScanner.h"
+#include "Trace.h"
+#include "Allocations.h"
+
+#define BENCHMARK_FRAMES		8
+#define BENCHMARK_THRESHOLD		0.97f	// the optimized shader has to be 3% faster to be used
+#define SPECIALIZE_TOLERANCE	(2.0f / 255)
+#define RENDER_ENGINE_MAX_OUTPUTS	8		// color attachments every GL 3 driver has
+#define COMPUTE_MAX_INVOCATIONS		1024	// per work group, the least GL 4.3 allows
+
+struct ShaderBenchmark {
+	float	original;	// ms per frame
+	float	optimized;
+};
+
+enum RenderBackend {
+	RENDER_FRAGMENT,	// one triangle over the target
+	RENDER_COMPUTE		// mainImage() in work group tiles, written with imageStore
+};
+
+struct BackendBenchmark {
+	float	fragment;	// ms per frame
+	float	compute;
+	int		tile[2];	// work group size it was timed with
+};
+
+struct TargetFormat {
+	string	label;
+	GLint	internalFormat;
+};
+
+static const TargetFormat targetFormats[] = {
+	{"8bit",		GL_RGB},
+	{"Half Float",	GL_RGBA16F},
+	{"Float",		GL_RGBA32F}
+};
+
+// A frame handed to a FrameCallback. The pixels belong to the engine and are
+// only valid during the call, they are overwritten by the next frame.
+struct RenderedFrame {
+	int			frame;
+	const void	*data;
+	int			width;
+	int			height;
+	int			channels;			// 3 for 8bit targets, 4 for float ones
+	int			bytesPerChannel;	// 1 or 4 (float)
+	size_t		size;
+};
+
+typedef function<void(const RenderedFrame&)> FrameCallback;
+
+// Renders a fragment shader to an offscreen target, without any UI: the
+// shader and its texture, movie, audio and data inputs, the optimizer and the
+// specializer. GLSLManager puts the app's controls on top of it, export and
+// the render server drive it directly, and it only needs openFrameworks, so
+// other tools can embed it with src/Engine, src/Input, src/Library and
+// src/Utils. All calls are GL calls and belong on the thread of the context.
+
+class RenderEngine {
+public:
+
+	// take effect on the next loadShader()
+	bool			optimize = false;
+	TextureOptions	textureDefaults;
+
+	// take effect on the next beginSpecialized() and applyTextureBudget()
+	bool			specialize = false;
+	int				textureBudget = 0;		// MB, 0 is unlimited
+
+	// take effect on the next frame, compute needs GL 4.3 and a shader
+	// with mainImage(out vec4, in vec2), and falls back to fragment otherwise
+	RenderBackend	backend = RENDER_FRAGMENT;
+	int				computeTile[2] = {16, 16};
+
+	// false with getErrorMessage() when the shader or an input fails
+	bool loadShader(string path) {
+
+		TRACE_SCOPE("RenderEngine::loadShader");
+
+		Allocations::settle();
+
+		ofFile file(path);
+
+		if (!file.exists()) {
+			compileSucceed = false;
+			errorMessage = "File does not exist";
+			return false;
+		}
+
+		ofBuffer buffer = file.readToBuffer();
+
+		ShaderDeclarations declarations;
+		{
+			TRACE_SCOPE("scan");
+			declarations = ShaderScanner::scan(buffer.getData(), buffer.size());
+		}
+
+		prefetchTextures(declarations);
+
+		string source = addMainImageEntry(buffer.getText());
+
+		// #pragma include is resolved from here, for every variant compiled later too
+		shaderDirectory = ofFilePath::getEnclosingDirectory(path);
+
+		// compile
+		ss.str("");
+		std::streambuf *old = std::cerr.rdbuf(ss.rdbuf());
+
+		{
+			TRACE_SCOPE("compile");
+			compileSucceed = shader.setupShaderFromSource(GL_FRAGMENT_SHADER, source, shaderDirectory);
+			shader.linkProgram();
+		}
+
+		std::cerr.rdbuf(old);
+
+		// set error message
+		if (compileSucceed) {
+
+			// identifies the shader for export journals, textures are named in the source
+			shaderHash = Hash::fnv1a(buffer.getData(), buffer.size());
+
+			// included files decide the pixels as much as the shader itself
+			for (auto& include : declarations.includes) {
+				ofBuffer included = ofBufferFromFile(ofFilePath::join(shaderDirectory, include.path), true);
+				shaderHash = Hash::fnv1a(include.path, shaderHash);
+				shaderHash = Hash::fnv1a(included.getData(), included.size(), shaderHash);
+			}
+
+			shaderSource = source;
+			cost = ShaderCostEstimator::estimate(source);
+
+			// one color attachment per output, the target is rebuilt when that changes
+			vector<string> names = readOutputNames(shaderSource);
+			bool reallocate = names.size() != outputNames.size() && target.isAllocated();
+			outputNames = names;
+
+			if (reallocate) {
+				allocate(getWidth(), getHeight(), allocatedFormat);
+			}
+
+			uniformTextures.clear();
+			videoTextures.clear();
+			audioTextures.clear();
+			audioLevelUniforms.clear();
+			dataTextures.clear();
+			dataUniforms.clear();
+
+			for (auto& uniform : declarations.uniforms) {
+
+				if (!isTextureDeclaration(uniform)) {
+					continue;
+				}
+
+				TRACE_SCOPE("texture");
+
+				const string &name = uniform.name;
+				string location = uniform.getLocation();
+
+				TextureOptions options = textureDefaults;
+				options.parse(uniform.getOptions());
+
+				// movies and image sequences stream in while rendering
+				if (VideoSource::isVideo(location)) {
+
+					if (cachedVideos.find(location) == cachedVideos.end()) {
+						ofLogNotice() << "Opening video:" << location;
+						auto video = make_shared<VideoSource>();
+						if (!video->open(ofToDataPath(location), frameRate)) {
+							compileSucceed = false;
+							errorMessage = "video \"" + location + "\" cannot be opened";
+							continue;
+						}
+						cachedVideos[location] = video;
+					}
+
+					videoTextures[name] = cachedVideos[location];
+					continue;
+				}
+
+				// soundtracks are analysed once and looked up per frame
+				if (AudioSource::isAudio(location)) {
+
+					if (cachedAudio.find(location) == cachedAudio.end()) {
+						ofLogNotice() << "Analysing audio:" << location;
+						auto audio = make_shared<AudioSource>();
+						if (!audio->open(ofToDataPath(location, true), frameRate)) {
+							compileSucceed = false;
+							errorMessage = "audio \"" + location + "\" cannot be decoded";
+							continue;
+						}
+						cachedAudio[location] = audio;
+					}
+
+					audioTextures[name] = cachedAudio[location];
+					audioLevelUniforms[name] = {{name + "_rms", name + "_bass", name + "_mid", name + "_treble"}};
+					continue;
+				}
+
+				// data files are mapped and sliced per frame
+				if (DataSource::isData(location)) {
+
+					DataOptions dataOptions;
+					dataOptions.parse(uniform.getOptions());
+					string key = location + " " + Hash::toHex(dataOptions.hash(0));
+
+					if (cachedData.find(key) == cachedData.end()) {
+						ofLogNotice() << "Mapping data:" << location;
+						auto data = make_shared<DataSource>();
+						if (!data->open(ofToDataPath(location, true), dataOptions)) {
+							compileSucceed = false;
+							errorMessage = "data \"" + location + "\" cannot be read";
+							continue;
+						}
+						cachedData[key] = data;
+					}
+
+					dataTextures[name] = cachedData[key];
+					dataUniforms[name] = {{name + "_count", name + "_size"}};
+					continue;
+				}
+
+				// search cached, the same image can be ingested with other options
+				string key = location + " " + Hash::toHex(options.hash(0));
+
+				if (cachedTextures.find(key) != cachedTextures.end()) {
+					// use cache
+					ofLogNotice() << "Using cached:" << location;
+					uniformTextures[name] = cachedTextures[key];
+
+				} else {
+
+					// fetched while the shader compiled
+					auto fetch = textureFetches.find(location);
+					pair<bool, ofBuffer> fetched;
+
+					if (fetch != textureFetches.end()) {
+						TRACE_SCOPE("wait");
+						fetched = fetch->second.get();
+					} else {
+						fetched = fetchTexture(location);
+					}
+
+					bool result = fetched.first;
+					const ofBuffer &source = fetched.second;
+
+					auto texture = make_shared<TextureAsset>();
+
+					if (result && texture->load(source, options)) {
+						uniformTextures[name] = texture;
+						cachedTextures[key] = texture;
+					} else {
+						compileSucceed = false;
+						errorMessage = "texture \"" + location + "\" does not exist";
+					}
+				}
+			}
+
+			applyTextureBudget();
+
+			loadOptimizedShader(shaderSource);
+
+		} else {
+
+			// get error
+			GLuint frag = shader.getShader(GL_FRAGMENT_SHADER);
+			GLsizei infoLength;
+
+			ofBuffer infoBuffer;
+			glGetShaderiv(frag, GL_INFO_LOG_LENGTH, &infoLength);
+			infoBuffer.allocate(infoLength);
+			glGetShaderInfoLog(frag, infoLength, &infoLength, infoBuffer.getData());
+
+			// remove lines inserted by ofLog
+			string lines = ss.str();
+
+			static size_t pos;
+			pos = lines.find(":\n");
+			if (pos != string::npos) {
+				lines.erase(0, pos + 2);
+			}
+
+			errorMessage = infoBuffer.getText() + "\n" + lines;
+		}
+
+		// waits for the fetches nobody asked for, they are not cancellable
+		textureFetches.clear();
+
+		return compileSucceed;
+	}
+
+	// `format` indexes targetFormats
+	void allocate(int w, int h, int format) {
+
+		GLint internalFormat = targetFormats[format].internalFormat;
+
+		ofFbo::Settings settings;
+		settings.width = w;
+		settings.height = h;
+		settings.internalformat = internalFormat;
+		settings.numColorbuffers = outputNames.size();
+
+		target.allocate(settings);
+		renderFbo.allocate(w, h, internalFormat);
+		allocatedFormat = format;
+
+		Allocations::settle();
+	}
+
+	void setSize(int w, int h)	{ allocate(w, h, allocatedFormat); }
+
+	// Values for uniforms the engine does not set itself. They are kept
+	// until changed and can be updated between frames.
+	void setUniform(const string &name, float x)							{ setCustomUniform(name, 1, x, 0, 0, 0); }
+	void setUniform(const string &name, float x, float y)					{ setCustomUniform(name, 2, x, y, 0, 0); }
+	void setUniform(const string &name, float x, float y, float z)			{ setCustomUniform(name, 3, x, y, z, 0); }
+	void setUniform(const string &name, float x, float y, float z, float w)	{ setCustomUniform(name, 4, x, y, z, w); }
+
+	// a sampler2D fed from the caller's own texture, shared rather than copied
+	void setTexture(const string &name, const ofTexture &texture) {
+		externalTextures[name] = texture;
+	}
+
+	void clearUniforms() {
+		customUniforms.clear();
+		externalTextures.clear();
+	}
+
+	// drops the ingested textures, videos, audio and data, so the next load reads them again
+	void clearCaches() {
+		cachedTextures.clear();
+		cachedVideos.clear();
+		cachedAudio.clear();
+		cachedData.clear();
+	}
+
+	void renderFrame(int frame) {
+
+		TRACE_SCOPE("RenderEngine::renderFrame");
+		ALLOCATION_SCOPE("RenderEngine::renderFrame");
+
+		if (backend == RENDER_COMPUTE && !specialized && loadComputeShader()) {
+			dispatchFrame(frame);
+			lastRenderedFrame = frame;
+			return;
+		}
+
+		target.begin();
+		{
+			if (outputNames.size() > 1) {
+				target.activateAllDrawBuffers();
+			}
+
+			ofBackground(0);
+			ofSetColor(255);
+
+			ofShader &active = getActiveShader();
+
+			active.begin();
+			setFrameUniforms(active, frame);
+
+			drawTriangle(target.getWidth(), target.getHeight());
+
+			active.end();
+		}
+		target.end();
+
+		lastRenderedFrame = frame;
+	}
+
+	// Renders only `region` of the frame, in target pixels from the bottom
+	// left, into the bottom left `w` x `h` pixels of getRegionTexture().
+	// gl_FragCoord and u_resolution read as they do in the full frame, so a
+	// preview of part of the frame, or of all of it at screen size, costs
+	// the pixels it shows. False when the shader cannot be rewritten for it.
+	bool renderRegion(int frame, const ofRectangle &region, int w, int h) {
+
+		TRACE_SCOPE("RenderEngine::renderRegion");
+		ALLOCATION_SCOPE("RenderEngine::renderRegion");
+
+		if (!compileSucceed || !loadRegionShader() || w < 1 || h < 1) {
+			return false;
+		}
+
+		if (!regionFbo.isAllocated() || regionFbo.getWidth() < w || regionFbo.getHeight() < h ||
+			regionFormat != allocatedFormat || regionFbo.getNumTextures() != outputNames.size()) {
+
+			// only grows, so zooming and panning do not reallocate
+			ofFbo::Settings settings;
+			settings.width = max(w, regionFbo.isAllocated() ? (int)regionFbo.getWidth() : 0);
+			settings.height = max(h, regionFbo.isAllocated() ? (int)regionFbo.getHeight() : 0);
+			settings.internalformat = targetFormats[allocatedFormat].internalFormat;
+			settings.numColorbuffers = outputNames.size();
+
+			regionFbo.allocate(settings);
+			regionFormat = allocatedFormat;
+		}
+
+		regionFbo.begin();
+		{
+			if (outputNames.size() > 1) {
+				regionFbo.activateAllDrawBuffers();
+			}
+
+			// the window origin is the bottom left in any case, so the
+			// scissor box is where roi_FragCoord starts
+			glEnable(GL_SCISSOR_TEST);
+			glScissor(0, 0, w, h);
+
+			ofBackground(0);
+			ofSetColor(255);
+
+			regionShader.begin();
+			setFrameUniforms(regionShader, frame);
+			regionShader.setUniform2f("roi_offset", region.x, region.y);
+			regionShader.setUniform2f("roi_scale", region.width / w, region.height / h);
+
+			drawTriangle(regionFbo.getWidth(), regionFbo.getHeight());
+
+			regionShader.end();
+
+			glDisable(GL_SCISSOR_TEST);
+		}
+		regionFbo.end();
+
+		lastRenderedFrame = frame;
+		return true;
+	}
+
+	// the last region, bottom up and larger than the region asked for
+	ofTexture& getRegionTexture(int output = 0) { return regionFbo.getTexture(output); }
+
+	// ofPixels, ofShortPixels or ofFloatPixels. The driver converts from the
+	// target format, float pixels always come back as RGBA.
+	template<typename PixelType>
+	void readToPixelsAtFrame(int frame, ofPixels_<PixelType> &pixels) {
+		TRACE_SCOPE("RenderEngine::readToPixelsAtFrame");
+
+		renderFrame(frame);
+		readToPixels(pixels);
+	}
+
+	// the first output of the last rendered frame
+	template<typename PixelType>
+	void readToPixels(ofPixels_<PixelType> &pixels) {
+
+		// fix vertical flip
+		renderFbo.begin();
+		ofPushMatrix();
+		{
+			ofBackground(0);
+			ofSetColor(255);
+
+			ofTranslate(0, target.getHeight());
+			ofScale(1, -1);
+			target.draw(0, 0);
+		}
+		ofPopMatrix();
+		renderFbo.end();
+
+		TRACE_SCOPE("readback");
+		renderFbo.readToPixels(pixels);
+	}
+
+	// Renders [begin, end) and reads every frame back into the same buffer,
+	// which `callback` borrows. 8bit targets come as RGB bytes, float targets
+	// as RGBA floats.
+	void renderFrames(int begin, int end, const FrameCallback &callback) {
+
+		RenderedFrame rendered;
+
+		for (int frame = begin; frame < end; frame++) {
+
+			{
+				ALLOCATION_SCOPE("RenderEngine::renderFrames");
+
+				if (isFloatTarget()) {
+					readToPixelsAtFrame(frame, floatPixels);
+					rendered.data = floatPixels.getData();
+					rendered.channels = floatPixels.getNumChannels();
+					rendered.bytesPerChannel = 4;
+				} else {
+					readToPixelsAtFrame(frame, pixels);
+					rendered.data = pixels.getData();
+					rendered.channels = pixels.getNumChannels();
+					rendered.bytesPerChannel = 1;
+				}
+			}
+
+			rendered.frame = frame;
+			rendered.width = getWidth();
+			rendered.height = getHeight();
+			rendered.size = (size_t)rendered.width * rendered.height * rendered.channels * rendered.bytesPerChannel;
+
+			callback(rendered);
+		}
+	}
+
+	// for passes that read the target directly on the GPU, it is bottom up
+	ofTexture& getTextureAtFrame(int frame) {
+		renderFrame(frame);
+		return target.getTexture();
+	}
+
+	// the last rendered frame, bottom up
+	ofTexture& getTexture(int output = 0) { return target.getTexture(output); }
+
+	// Starts copying outputs 1 and up of the last rendered frame into pixel
+	// buffer objects, so the transfers run while output 0 is read back.
+	// `type` is GL_UNSIGNED_BYTE or GL_FLOAT, with getNumChannels() channels.
+	void beginReadOutputs(GLenum type) {
+
+		TRACE_SCOPE("RenderEngine::beginReadOutputs");
+
+		size_t size = getOutputSize(type);
+		GLenum format = getNumChannels() == 4 ? GL_RGBA : GL_RGB;
+
+		outputBuffers.resize(outputNames.size());
+		glPixelStorei(GL_PACK_ALIGNMENT, 1);
+
+		for (int i = 1; i < outputNames.size(); i++) {
+
+			if (outputBuffers[i].size() != size) {
+				outputBuffers[i].allocate(size, GL_STREAM_READ);
+			}
+
+			const ofTextureData &data = target.getTexture(i).getTextureData();
+
+			outputBuffers[i].bind(GL_PIXEL_PACK_BUFFER);
+			glBindTexture(data.textureTarget, data.textureID);
+			glGetTexImage(data.textureTarget, 0, format, type, 0);
+			glBindTexture(data.textureTarget, 0);
+			outputBuffers[i].unbind(GL_PIXEL_PACK_BUFFER);
+		}
+
+		glPixelStorei(GL_PACK_ALIGNMENT, 4);
+	}
+
+	// waits for output `index` and copies it top down into `dst`, which holds
+	// getOutputSize(type) bytes
+	void finishReadOutput(int index, GLenum type, void *dst) {
+
+		TRACE_SCOPE("RenderEngine::finishReadOutput");
+
+		size_t rowSize = getOutputSize(type) / getHeight();
+		int h = getHeight();
+
+		const unsigned char *src = (const unsigned char*)outputBuffers[index].map(GL_READ_ONLY);
+
+		if (src == NULL) {
+			return;
+		}
+
+		for (int y = 0; y < h; y++) {
+			memcpy((unsigned char*)dst + y * rowSize, src + (h - 1 - y) * rowSize, rowSize);
+		}
+
+		outputBuffers[index].unmap();
+	}
+
+	// bytes of one output read back as `type`
+	size_t getOutputSize(GLenum type) {
+		return (size_t)getWidth() * getHeight() * getNumChannels() * (type == GL_FLOAT ? sizeof(float) : 1);
+	}
+
+	// channels read back, float targets come back as RGBA
+	int getNumChannels()					{ return isFloatTarget() ? 4 : 3; }
+
+	// 1 unless the shader writes gl_FragData[N] or layout(location = N) outputs
+	int getNumOutputs()						{ return outputNames.size(); }
+	const string& getOutputName(int index)	{ return outputNames[index]; }
+
+	// milliseconds, waits for the GPU to finish
+	float timeRender(int frame) {
+		uint64_t start = ofGetElapsedTimeMicros();
+		renderFrame(frame);
+		glFinish();
+		return (ofGetElapsedTimeMicros() - start) / 1000.0f;
+	}
+
+	// the soundtrack muxed into exports, the first audio input if any
+	string getAudioPath() {
+		return audioTextures.empty() ? "" : audioTextures.begin()->second->getPath();
+	}
+
+	// For export: compiles the shader again with every uniform but the ones
+	// that change per frame turned into constants, and uses it only if a
+	// sample frame renders the same as with the generic shader.
+	void beginSpecialized() {
+
+		specialized = false;
+
+		if (!specialize || !compileSucceed) {
+			specializeLog = "";
+			return;
+		}
+
+		map<string, string> values = {
+			{"u_resolution", "vec2(" + ofToString(target.getWidth(), 1) + ", " + ofToString(target.getHeight(), 1) + ")"}
+		};
+
+		set<string> dynamic = {"u_time"};
+		for (auto& iter : uniformTextures)	dynamic.insert(iter.first);
+		for (auto& iter : videoTextures)	dynamic.insert(iter.first);
+		for (auto& iter : customUniforms)	dynamic.insert(iter.first);
+		for (auto& iter : externalTextures)	dynamic.insert(iter.first);
+		for (auto& iter : audioTextures) {
+			for (string suffix : {"", "_rms", "_bass", "_mid", "_treble"}) {
+				dynamic.insert(iter.first + suffix);
+			}
+		}
+		for (auto& iter : dataTextures) {
+			for (string suffix : {"", "_count", "_size"}) {
+				dynamic.insert(iter.first + suffix);
+			}
+		}
+
+		int count;
+		string source = ShaderSpecializer::specialize(useOptimized ? optimizedSource : shaderSource, values, dynamic, &count);
+		specializedHash = Hash::fnv1a(source);
+
+		specializedShader.unload();
+
+		if (count == 0) {
+			specializeLog = "Nothing to specialize";
+			return;
+		}
+
+		if (!specializedShader.setupShaderFromSource(GL_FRAGMENT_SHADER, source, shaderDirectory) || !specializedShader.linkProgram()) {
+			specializeLog = "Specialized shader does not compile";
+			return;
+		}
+
+		// the same frame both ways must match
+		int frame = duration / 2;
+		ofFloatPixels generic, constant;
+
+		readToPixelsAtFrame(frame, generic);
+		specialized = true;
+		readToPixelsAtFrame(frame, constant);
+		specialized = false;
+
+		float diff = 0;
+		for (size_t i = 0; i < generic.size() && i < constant.size(); i++) {
+			diff = max(diff, fabs(generic[i] - constant[i]));
+		}
+
+		if (generic.size() != constant.size() || diff > SPECIALIZE_TOLERANCE) {
+			specializeLog = "Specialized output differs, not used";
+			return;
+		}
+
+		float times[2] = {0, 0};
+		for (int i = 0; i < BENCHMARK_FRAMES * 2; i++) {
+			specialized = i % 2 != 0;
+			times[specialized] += timeRender(duration * (i / 2) / BENCHMARK_FRAMES);
+		}
+
+		specialized = true;
+		specializeLog = ofToString(count) + " uniforms specialized, " + ofToString(times[0] / max(times[1], 0.001f), 2) + "x";
+
+		ofLogNotice("RenderEngine") << specializeLog;
+	}
+
+	void endSpecialized() {
+		specialized = false;
+	}
+
+	// every frame comes out the same: the linked program has no active u_time,
+	// there are no movie or audio inputs, data inputs have one frame and no
+	// external textures are bound, their owner may change them at any time
+	bool isTimeInvariant() {
+
+		if (!externalTextures.empty()) {
+			return false;
+		}
+
+		for (auto& iter : dataTextures) {
+			if (!iter.second->isStatic()) {
+				return false;
+			}
+		}
+
+		return compileSucceed && getActiveShader().getUniformLocation("u_time") < 0 &&
+			videoTextures.empty() && audioTextures.empty();
+	}
+
+	// false while a video input is still decoding `frame`, so export can
+	// come back to it instead of waiting
+	bool isFrameReady(int frame) {
+		bool ready = true;
+		for (auto& iter : videoTextures) {
+			iter.second->request(frame, frameRate);
+			ready = ready && iter.second->isFrameReady(frame);
+		}
+		return ready;
+	}
+
+	// Renders the same frames with both shaders, alternating so clocks and
+	// caches affect both alike, and keeps whichever is faster.
+	void runBenchmark() {
+
+		if (!compileSucceed || !optimizedShader.isLoaded()) {
+			return;
+		}
+
+		float times[2] = {0, 0};
+		uint64_t allocations = 0;
+
+		for (int i = -2; i < BENCHMARK_FRAMES * 2; i++) {
+
+			useOptimized = i % 2 != 0;
+			int frame = duration * max(0, i / 2) / BENCHMARK_FRAMES;
+
+			uint64_t count = Allocations::threadCount();
+			float ms = timeRender(frame);
+
+			// the first pair only warms up
+			if (i >= 0) {
+				times[useOptimized] += ms;
+				allocations += Allocations::threadCount() - count;
+			}
+		}
+
+		ShaderBenchmark &result = benchmarks[shaderHash];
+		result.original = times[0] / BENCHMARK_FRAMES;
+		result.optimized = times[1] / BENCHMARK_FRAMES;
+
+		useOptimized = result.optimized < result.original * BENCHMARK_THRESHOLD;
+
+		ofLogNotice("RenderEngine") << "Benchmark " << result.original << "ms, " << result.optimized << "ms optimized"
+			<< (Allocations::isTracking() ? ", " + ofToString(allocations / (BENCHMARK_FRAMES * 2.0f)) + " allocations per frame" : "");
+	}
+
+	// Renders the same frames with the fragment and the compute backend,
+	// alternating like runBenchmark(), and keeps the one that was set.
+	void runBackendBenchmark() {
+
+		RenderBackend selected = backend;
+		backend = RENDER_COMPUTE;
+
+		if (!compileSucceed || !loadComputeShader()) {
+			backend = selected;
+			return;
+		}
+
+		float times[2] = {0, 0};
+
+		for (int i = -2; i < BENCHMARK_FRAMES * 2; i++) {
+
+			backend = i % 2 != 0 ? RENDER_COMPUTE : RENDER_FRAGMENT;
+			float ms = timeRender(duration * max(0, i / 2) / BENCHMARK_FRAMES);
+
+			// the first pair only warms up
+			if (i >= 0) {
+				times[backend] += ms;
+			}
+		}
+
+		backend = selected;
+
+		BackendBenchmark &result = backendBenchmarks[shaderHash];
+		result.fragment = times[RENDER_FRAGMENT] / BENCHMARK_FRAMES;
+		result.compute = times[RENDER_COMPUTE] / BENCHMARK_FRAMES;
+		result.tile[0] = computeTile[0];
+		result.tile[1] = computeTile[1];
+
+		ofLogNotice("RenderEngine") << "Backends " << result.fragment << "ms fragment, " << result.compute << "ms compute in "
+			<< computeTile[0] << "x" << computeTile[1] << " tiles";
+	}
+
+	// the GL context can run compute shaders and image stores
+	static bool isComputeSupported() {
+#ifndef TARGET_OPENGLES
+		return GLEW_VERSION_4_3;
+#else
+		return false;
+#endif
+	}
+
+	// the backend frames are actually rendered with
+	RenderBackend getActiveBackend() {
+		return backend == RENDER_COMPUTE && loadComputeShader() ? RENDER_COMPUTE : RENDER_FRAGMENT;
+	}
+
+	// why compute is not used, empty when it is
+	const string& getComputeLog()			{ return computeLog; }
+
+	// NULL until runBackendBenchmark() has timed this shader
+	const BackendBenchmark* getBackendBenchmark() {
+		auto it = backendBenchmarks.find(shaderHash);
+		return it != backendBenchmarks.end() ? &it->second : NULL;
+	}
+
+	// Leaves out the top mip level of whichever texture has the largest one
+	// until they all fit textureBudget. An explicit max= keeps its size.
+	void applyTextureBudget() {
+
+		set<shared_ptr<TextureAsset>> assets;
+		for (auto& iter : uniformTextures) {
+			assets.insert(iter.second);
+		}
+
+		map<TextureAsset*, int> skips;
+		size_t total = 0;
+
+		for (auto& asset : assets) {
+			skips[asset.get()] = 0;
+			total += asset->getMemory(0);
+		}
+
+		auto topLevel = [&](TextureAsset *asset) {
+			int skip = skips[asset];
+			return asset->getMemory(skip) - asset->getMemory(skip + 1);
+		};
+
+		size_t budget = (size_t)textureBudget * 1024 * 1024;
+
+		while (budget > 0 && total > budget) {
+
+			TextureAsset *largest = NULL;
+
+			for (auto& asset : assets) {
+				if (!asset->isPinned() && skips[asset.get()] + 1 < asset->getNumLevels() &&
+					(largest == NULL || topLevel(asset.get()) > topLevel(largest))) {
+					largest = asset.get();
+				}
+			}
+
+			if (largest == NULL) {
+				break;
+			}
+
+			total -= topLevel(largest);
+			skips[largest]++;
+		}
+
+		for (auto& asset : assets) {
+			asset->upload(skips[asset.get()]);
+		}
+	}
+
+	float getWidth()	{ return target.getWidth(); }
+	float getHeight()	{ return target.getHeight(); }
+	int getFrameRate()	{ return frameRate; }
+	int getDuration()	{ return duration; }
+	int getFormat()		{ return allocatedFormat; }
+	bool isCompiled()	{ return compileSucceed; }
+	bool isFloatTarget() { return targetFormats[allocatedFormat].internalFormat != GL_RGB; }
+	int getLastRenderedFrame() { return lastRenderedFrame; }
+	const string& getErrorMessage() { return errorMessage; }
+
+	void setDuration(int d)		{ duration = d; }
+	void setFrameRate(int fps)	{ frameRate = fps; }
+
+	uint64_t getShaderHash()	{ return shaderHash; }
+	const ShaderCost& getCost()	{ return cost; }
+
+	const map<string, shared_ptr<TextureAsset>>& getTextures() { return uniformTextures; }
+
+	// Everything but the frame number that decides the rendered pixels: the
+	// source, size, format, the program that runs, custom uniforms and the
+	// contents of images and soundtracks. Movies count by their location,
+	// binary data files by location, size and modification time.
+	// 0 while external textures are bound, their contents are not known.
+	uint64_t getContentHash() {
+
+		if (!externalTextures.empty()) {
+			return 0;
+		}
+
+		uint64_t h = Hash::combine(shaderHash, getWidth());
+		h = Hash::combine(h, getHeight());
+		h = Hash::combine(h, allocatedFormat);
+		h = Hash::combine(h, frameRate);
+		h = Hash::combine(h, getActiveProgramHash());
+		h = Hash::combine(h, getActiveBackend());
+
+		for (const auto& iter : customUniforms) {
+			h = Hash::fnv1a(iter.first, h);
+			h = Hash::combine(h, iter.second.size);
+			h = Hash::fnv1a(iter.second.values, sizeof(float) * iter.second.size, h);
+		}
+
+		for (const auto& iter : uniformTextures) {
+			h = Hash::fnv1a(iter.first, h);
+			h = Hash::combine(h, iter.second->getKey());
+			h = Hash::combine(h, iter.second->getSkip());
+		}
+
+		for (const auto& iter : audioTextures) {
+			h = Hash::fnv1a(iter.first, h);
+			h = Hash::combine(h, iter.second->getSourceHash());
+		}
+
+		for (const auto& iter : dataTextures) {
+			h = Hash::fnv1a(iter.first, h);
+			h = Hash::combine(h, iter.second->getKey());
+		}
+
+		return h;
+	}
+
+	bool hasOptimizedShader()				{ return optimizedShader.isLoaded(); }
+	bool isUsingOptimized()					{ return useOptimized; }
+	const string& getOptimizeLog()			{ return optimizeLog; }
+	const string& getSpecializeLog()		{ return specializeLog; }
+
+	// NULL until runBenchmark() has timed this shader
+	const ShaderBenchmark* getBenchmark() {
+		auto it = benchmarks.find(shaderHash);
+		return it != benchmarks.end() ? &it->second : NULL;
+	}
+
+	// A shader with only mainImage() gets a main() that calls it, so the
+	// same source runs on both backends and in thumbnails.
+	static string addMainImageEntry(const string &source) {
+
+		if (regex_search(source, getMainRegex()) || !regex_search(source, getMainImageRegex())) {
+			return source;
+		}
+
+		return source + "\nvoid main() {\n\tmainImage(gl_FragColor, gl_FragCoord.xy);\n}\n";
+	}
+
+private:
+
+	struct CustomUniform {
+		int		size;
+		float	values[4];
+	};
+
+	void setCustomUniform(const string &name, int size, float x, float y, float z, float w) {
+		CustomUniform &u = customUniforms[name];
+		u.size = size;
+		u.values[0] = x;
+		u.values[1] = y;
+		u.values[2] = z;
+		u.values[3] = w;
+	}
+
+	// `uniform sampler2D name; // location options`
+	static bool isTextureDeclaration(const ShaderUniform &uniform) {
+		return uniform.type == "sampler2D" && uniform.arraySize == 0 && !uniform.annotation.empty();
+	}
+
+	// the bytes of an image file or URL, called on loader threads
+	static pair<bool, ofBuffer> fetchTexture(string location) {
+
+		static const regex urlRegex("^https?://.+$");
+
+		if (regex_match(location, urlRegex)) {
+			ofLogNotice() << "Loading from URL:" << location;
+			ofHttpResponse response = ofLoadURL(location);
+			return make_pair(response.status == 200, response.data);
+		}
+
+		ofLogNotice() << "Loading from File:" << location;
+
+		if (!ofFile::doesFileExist(location)) {
+			return make_pair(false, ofBuffer());
+		}
+		return make_pair(true, ofBufferFromFile(location, true));
+	}
+
+	// Starts fetching the images of `source` that are not cached yet, each
+	// on a thread of its own, so downloads and file reads run in parallel
+	// and while the shader compiles.
+	void prefetchTextures(const ShaderDeclarations &declarations) {
+
+		TRACE_SCOPE("prefetch");
+
+		textureFetches.clear();
+
+		for (auto& uniform : declarations.uniforms) {
+
+			if (!isTextureDeclaration(uniform)) {
+				continue;
+			}
+
+			string location = uniform.getLocation();
+
+			TextureOptions options = textureDefaults;
+			options.parse(uniform.getOptions());
+
+			if (VideoSource::isVideo(location) || AudioSource::isAudio(location) || DataSource::isData(location) || textureFetches.count(location) ||
+				cachedTextures.count(location + " " + Hash::toHex(options.hash(0)))) {
+				continue;
+			}
+
+			textureFetches[location] = async(launch::async, &RenderEngine::fetchTexture, location).share();
+		}
+	}
+
+	// Output names by location, from `layout(location = N) out vec4 name;`
+	// declarations or `outputN` for gl_FragData[N]. The first is always there.
+	static vector<string> readOutputNames(const string &source) {
+
+		static regex fragDataRegex("gl_FragData[ \t]*\\[[ \t]*([0-9]+)[ \t]*\\]");
+		static regex layoutRegex("layout[ \t]*\\([ \t]*location[ \t]*=[ \t]*([0-9]+)[ \t]*\\)[ \t]*out[ \t]+[A-Za-z0-9_]+[ \t]+([A-Za-z0-9_]+)");
+
+		map<int, string> outputs = {{0, "output0"}};
+
+		for (sregex_iterator it(source.begin(), source.end(), fragDataRegex), end; it != end; ++it) {
+			int index = ofToInt((*it)[1].str());
+			outputs.insert(make_pair(index, "output" + ofToString(index)));
+		}
+
+		for (sregex_iterator it(source.begin(), source.end(), layoutRegex), end; it != end; ++it) {
+			outputs[ofToInt((*it)[1].str())] = (*it)[2].str();
+		}
+
+		// attachments are contiguous, gaps get a name of their own
+		int count = min(outputs.rbegin()->first + 1, RENDER_ENGINE_MAX_OUTPUTS);
+		vector<string> names(count);
+
+		for (int i = 0; i < count; i++) {
+			names[i] = outputs.count(i) ? outputs[i] : "output" + ofToString(i);
+		}
+
+		return names;
+	}
+
+	// One triangle twice the size of the `w` x `h` rectangle, so the
+	// rectangle is covered without the diagonal two triangles shade twice.
+	// The vertices are uploaded once, and ofVbo keeps them in a VAO
+	// wherever the context has them.
+	void drawTriangle(float w, float h) {
+
+		if (!triangle.getIsAllocated()) {
+			const ofVec3f vertices[] = {ofVec3f(0, 0), ofVec3f(2, 0), ofVec3f(0, 2)};
+			triangle.setVertexData(vertices, 3, GL_STATIC_DRAW);
+		}
+
+		ofPushMatrix();
+		ofScale(w, h);
+		triangle.draw(GL_TRIANGLES, 0, 3);
+		ofPopMatrix();
+	}
+
+	// Runs the compute shader over the target in computeTile work groups.
+	// Float targets are written in place, 8bit ones are RGB, which images
+	// cannot be, so they go through an RGBA8 texture and one copy pass.
+	void dispatchFrame(int frame) {
+
+		int w = getWidth(), h = getHeight();
+		bool direct = targetFormats[allocatedFormat].internalFormat != GL_RGB;
+
+		if (!direct && (!computeImage.isAllocated() || computeImage.getWidth() != w || computeImage.getHeight() != h)) {
+			computeImage.allocate(w, h, GL_RGBA8);
+			computeImage.setTextureMinMagFilter(GL_NEAREST, GL_NEAREST);
+		}
+
+		const ofTextureData &data = (direct ? target.getTexture() : computeImage).getTextureData();
+
+		computeShader.begin();
+		setFrameUniforms(computeShader, frame);
+		glBindImageTexture(0, data.textureID, 0, GL_FALSE, 0, GL_WRITE_ONLY, data.glInternalFormat);
+		computeShader.dispatchCompute((w + computeTile[0] - 1) / computeTile[0], (h + computeTile[1] - 1) / computeTile[1], 1);
+		computeShader.end();
+
+		// anything may read the target next, the readback, the preview or a copy
+		glMemoryBarrier(GL_ALL_BARRIER_BITS);
+
+		if (direct) {
+			return;
+		}
+
+		target.begin();
+		{
+			copyShader.begin();
+			copyShader.setUniformTexture("tex", computeImage, 0);
+			copyShader.setUniform2f("size", w, h);
+			drawTriangle(w, h);
+			copyShader.end();
+		}
+		target.end();
+	}
+
+	// The compute variant of the generic shader for the current tile size and
+	// target format, compiled the first time it is needed. Sets computeLog.
+	bool loadComputeShader() {
+
+		uint64_t key = Hash::combine(shaderHash, computeTile);
+		key = Hash::combine(key, allocatedFormat);
+
+		if (key == computeShaderKey) {
+			return computeShader.isLoaded();
+		}
+
+		computeShaderKey = key;
+		computeShader.unload();
+
+		static const char *imageFormats[] = {"rgba8", "rgba16f", "rgba32f"};
+		// from the original, the optimizer's output need not keep mainImage() apart
+		string source = makeComputeSource(shaderSource, computeTile[0], computeTile[1], imageFormats[allocatedFormat]);
+
+		if (!isComputeSupported()) {
+			computeLog = "Compute needs OpenGL 4.3";
+		} else if (computeTile[0] < 1 || computeTile[1] < 1 || computeTile[0] * computeTile[1] > COMPUTE_MAX_INVOCATIONS) {
+			computeLog = "Tiles are at most " + ofToString(COMPUTE_MAX_INVOCATIONS) + " invocations";
+		} else if (outputNames.size() > 1) {
+			computeLog = "Compute writes one output";
+		} else if (source.empty()) {
+			computeLog = "Compute needs mainImage(out vec4, in vec2)";
+		} else if (!computeShader.setupShaderFromSource(GL_COMPUTE_SHADER, source, shaderDirectory) || !computeShader.linkProgram()) {
+			computeLog = "The compute shader does not compile";
+		} else {
+			computeLog = "";
+		}
+
+		if (!computeLog.empty()) {
+			ofLogWarning("RenderEngine") << computeLog << ", rendering with the fragment backend";
+			computeShader.unload();
+			return false;
+		}
+
+		if (!copyShader.isLoaded()) {
+			copyShader.setupShaderFromSource(GL_FRAGMENT_SHADER, R"(
+				#version 120
+
+				uniform sampler2D tex;
+				uniform vec2 size;
+
+				void main() {
+					gl_FragColor = texture2D(tex, gl_FragCoord.xy / size);
+				}
+			)");
+			copyShader.linkProgram();
+		}
+
+		return true;
+	}
+
+	// `void main()` and `void mainImage(out vec4, in vec2)` definitions
+	static const regex& getMainRegex() {
+		static const regex mainRegex("void[ \t\r\n]+main[ \t\r\n]*\\([ \t\r\n]*(void)?[ \t\r\n]*\\)[ \t\r\n]*\\{");
+		return mainRegex;
+	}
+
+	static const regex& getMainImageRegex() {
+		static const regex mainImageRegex("void[ \t\r\n]+mainImage[ \t\r\n]*\\(");
+		return mainImageRegex;
+	}
+
+	// The mainImage() of `source` behind a compute main() that calls it once
+	// per pixel, with the same fragCoord the fragment backend passes. Empty
+	// when `source` has no mainImage().
+	static string makeComputeSource(const string &source, int tileX, int tileY, const string &imageFormat) {
+
+		static const regex addedMainRegex("\nvoid main\\(\\) \\{\n\tmainImage\\(gl_FragColor, gl_FragCoord\\.xy\\);\n\\}\n$");
+		static const regex versionRegex("^[ \t]*#[ \t]*version\\b.*$");
+		static const regex extensionRegex("^[ \t]*#[ \t]*extension\\b.*$");
+
+		if (!regex_search(source, getMainImageRegex())) {
+			return "";
+		}
+
+		// the main() of addMainImageEntry() is replaced, a main() of the shader's own would clash
+		string body = regex_replace(source, addedMainRegex, "\n");
+
+		if (regex_search(body, getMainRegex())) {
+			return "";
+		}
+
+		stringstream in(body);
+		string extensions, rest, line;
+
+		while (getline(in, line)) {
+			if (regex_match(line, versionRegex)) {
+				continue;
+			}
+			(regex_match(line, extensionRegex) ? extensions : rest) += line + "\n";
+		}
+
+		return "#version 430 compatibility\n" + extensions +
+			"layout(local_size_x = " + ofToString(tileX) + ", local_size_y = " + ofToString(tileY) + ") in;\n"
+			"layout(" + imageFormat + ") uniform writeonly image2D u_output;\n" +
+			rest +
+			"\nvoid main() {\n"
+			"\tivec2 p = ivec2(gl_GlobalInvocationID.xy);\n"
+			"\tif (any(greaterThanEqual(p, imageSize(u_output)))) return;\n"
+			"\tvec4 color = vec4(0.0);\n"
+			"\tmainImage(color, vec2(p) + 0.5);\n"
+			"\timageStore(u_output, p, color);\n"
+			"}\n";
+	}
+
+	// u_time, u_resolution, custom uniforms and every input, for `frame`
+	void setFrameUniforms(ofShader &active, int frame) {
+
+		active.setUniform1f("u_time", (float)frame / frameRate);
+		active.setUniform2f("u_resolution", target.getWidth(), target.getHeight());
+
+		for (const auto& iter : customUniforms) {
+			const CustomUniform &u = iter.second;
+			switch (u.size) {
+				case 1: active.setUniform1f(iter.first, u.values[0]); break;
+				case 2: active.setUniform2f(iter.first, u.values[0], u.values[1]); break;
+				case 3: active.setUniform3f(iter.first, u.values[0], u.values[1], u.values[2]); break;
+				case 4: active.setUniform4f(iter.first, u.values[0], u.values[1], u.values[2], u.values[3]); break;
+			}
+		}
+
+		// by reference, and with names built at load, so nothing is allocated per frame
+		int i = 0;
+		for (const auto& iter : uniformTextures) {
+			active.setUniformTexture(iter.first, iter.second->getTexture(), i++);
+		}
+
+		for (const auto& iter : externalTextures) {
+			active.setUniformTexture(iter.first, iter.second, i++);
+		}
+
+		for (const auto& iter : videoTextures) {
+			iter.second->request(frame, frameRate);
+			active.setUniformTexture(iter.first, iter.second->getTexture(frame), i++);
+		}
+
+		for (const auto& iter : audioTextures) {
+			AudioSource &audio = *iter.second;
+			audio.setFrameRate(frameRate);
+
+			const AudioFrame &levels = audio.getFrame(frame);
+			const array<string, 4> &names = audioLevelUniforms[iter.first];
+			active.setUniformTexture(iter.first, audio.getTexture(frame), i++);
+			active.setUniform1f(names[0], levels.rms);
+			active.setUniform1f(names[1], levels.bass);
+			active.setUniform1f(names[2], levels.mid);
+			active.setUniform1f(names[3], levels.treble);
+		}
+
+		for (const auto& iter : dataTextures) {
+			DataSource &data = *iter.second;
+			const array<string, 2> &names = dataUniforms[iter.first];
+			active.setUniformTexture(iter.first, data.getTexture(frame, frameRate), i++);
+			active.setUniform1f(names[0], data.getCount(frame, frameRate));
+			active.setUniform2f(names[1], data.getWidth(), data.getHeight());
+		}
+	}
+
+	// The generic shader with gl_FragCoord read through `roi_offset` and
+	// `roi_scale`, compiled the first time a region is rendered after a load
+	bool loadRegionShader() {
+
+		uint64_t key = Hash::combine(shaderHash, useOptimized);
+
+		if (key == regionShaderKey) {
+			return regionShader.isLoaded();
+		}
+
+		regionShaderKey = key;
+		regionShader.unload();
+
+		string source = makeRegionSource(useOptimized ? optimizedSource : shaderSource);
+
+		if (source.empty() || !regionShader.setupShaderFromSource(GL_FRAGMENT_SHADER, source, shaderDirectory) || !regionShader.linkProgram()) {
+			ofLogWarning("RenderEngine") << "The shader cannot render regions, previewing whole frames";
+			regionShader.unload();
+			return false;
+		}
+
+		return true;
+	}
+
+	// gl_FragCoord becomes a global set at the top of main(), declared after
+	// the #version and #extension lines. Empty when there is no main().
+	static string makeRegionSource(const string &source) {
+
+		static const regex fragCoordRegex("\\bgl_FragCoord\\b");
+		static const regex directiveRegex("^[ \t]*#[ \t]*(version|extension)\\b.*$");
+
+		smatch m;
+
+		if (!regex_search(source, m, getMainRegex())) {
+			return "";
+		}
+
+		string body = regex_replace(string(source, m.position(0) + m.length(0)), fragCoordRegex, "roi_FragCoord");
+		string head = regex_replace(string(source, 0, m.position(0)), fragCoordRegex, "roi_FragCoord");
+
+		// directives stay first
+		stringstream in(head);
+		string directives, rest, line;
+
+		while (getline(in, line)) {
+			(regex_match(line, directiveRegex) ? directives : rest) += line + "\n";
+		}
+
+		return directives +
+			"uniform vec2 roi_offset;\n"
+			"uniform vec2 roi_scale;\n"
+			"vec4 roi_FragCoord;\n" +
+			rest + m.str(0) +
+			"\n\troi_FragCoord = vec4(gl_FragCoord.xy * roi_scale + roi_offset, gl_FragCoord.zw);\n" +
+			body;
+	}
+
+	ofShader& getActiveShader() {
+		return specialized ? specializedShader : useOptimized ? optimizedShader : shader;
+	}
+
+	// the source getActiveShader() was built from, the settings only ask for
+	// an optimized or specialized program that may then not be used
+	uint64_t getActiveProgramHash() {
+		if (specialized) {
+			return specializedHash;
+		}
+		return useOptimized ? Hash::fnv1a(optimizedSource) : shaderHash;
+	}
+
+	// compiled next to the original when optimize is on, and used unless a
+	// benchmark of this source found it slower
+	void loadOptimizedShader(const string &source) {
+
+		useOptimized = false;
+
+		if (!optimize) {
+			return;
+		}
+
+		optimizedSource = ShaderOptimizer::optimize(source, &optimizeLog);
+
+		optimizedShader.unload();
+
+		if (!optimizedShader.setupShaderFromSource(GL_FRAGMENT_SHADER, optimizedSource, shaderDirectory) || !optimizedShader.linkProgram()) {
+			optimizeLog = "the optimized shader does not compile, using the original";
+			optimizedShader.unload();
+			return;
+		}
+
+		auto it = benchmarks.find(shaderHash);
+		useOptimized = it == benchmarks.end() || it->second.optimized < it->second.original * BENCHMARK_THRESHOLD;
+	}
+
+	map<string, shared_ptr<TextureAsset>>	uniformTextures;
+	map<string, shared_ptr<TextureAsset>>	cachedTextures;
+
+	map<string, shared_ptr<VideoSource>>	videoTextures;
+	map<string, shared_ptr<VideoSource>>	cachedVideos;
+
+	map<string, shared_ptr<AudioSource>>	audioTextures;
+	map<string, shared_ptr<AudioSource>>	cachedAudio;
+	map<string, array<string, 4>>			audioLevelUniforms;	// <name>_rms, _bass, _mid, _treble
+
+	map<string, shared_ptr<DataSource>>		dataTextures;
+	map<string, shared_ptr<DataSource>>		cachedData;		// by location and options
+	map<string, array<string, 2>>			dataUniforms;	// <name>_count, _size
+
+	map<string, shared_future<pair<bool, ofBuffer>>>	textureFetches;		// by location, during loadShader()
+
+	map<string, CustomUniform>	customUniforms;
+	map<string, ofTexture>		externalTextures;
+
+	ofFbo			target;
+	ofFbo			renderFbo; // to fix vertical flip when rendering
+
+	vector<string>			outputNames = {"output0"};
+	vector<ofBufferObject>	outputBuffers;		// readback of outputs 1 and up
+
+	// reused by renderFrames()
+	ofPixels		pixels;
+	ofFloatPixels	floatPixels;
+
+	stringstream	ss;
+	string			errorMessage;
+
+	int				duration = 120;
+	int				frameRate = 30;
+	int				allocatedFormat = 0;
+	int				lastRenderedFrame = 0;
+
+	bool			compileSucceed = false;
+	uint64_t		shaderHash = 0;
+	ShaderCost		cost;
+
+	ofShader		shader;
+	string			shaderSource;		// as in the file, includes not expanded
+	string			shaderDirectory;	// includes of every variant are resolved from here
+
+	bool			useOptimized = false;
+	ofShader		optimizedShader;
+	string			optimizedSource;
+	string			optimizeLog;
+	map<uint64_t, ShaderBenchmark>	benchmarks;	// by shader hash
+
+	bool			specialized = false;
+	uint64_t		specializedHash = 0;
+	ofShader		specializedShader;
+	string			specializeLog;
+
+	ofVbo			triangle;
+
+	ofShader		computeShader;
+	uint64_t		computeShaderKey = 0;
+	string			computeLog;
+	ofTexture		computeImage;		// for 8bit targets
+	ofShader		copyShader;
+	map<uint64_t, BackendBenchmark>	backendBenchmarks;	// by shader hash
+
+	ofShader		regionShader;
+	uint64_t		regionShaderKey = 0;
+	ofFbo			regionFbo;
+	int				regionFormat = 0;
+};
@@ -0,0 +1,212 @@
+#pragma once
+
+#include "ofMain.h"
+
+enum DownsampleFilter {
+	DOWNSAMPLE_BOX,
+	DOWNSAMPLE_LANCZOS
+};
+
+// Shrinks the rendered frame on the GPU for the proxy outputs of an export.
+// While the source is more than twice the size it is halved with box
+// passes, then one last pass filters the rest with a box or a 2 lobe
+// Lanczos kernel. The last pass also flips the image, so the readback is
+// top down like ffmpeg and the sequence writer expect it.
+
+class Downsampler {
+public:
+
+	static const char* getFilterName(DownsampleFilter filter) {
+		return filter == DOWNSAMPLE_BOX ? "box" : "lanczos";
+	}
+
+	// DOWNSAMPLE_LANCZOS for anything but "box"
+	static DownsampleFilter fromName(const string &name) {
+		return name == "box" ? DOWNSAMPLE_BOX : DOWNSAMPLE_LANCZOS;
+	}
+
+	void setup() {
+		shader.setupShaderFromSource(GL_FRAGMENT_SHADER, getFragmentSource());
+		shader.linkProgram();
+	}
+
+	// `internalFormat` of the passes, the same as the render target so float
+	// frames stay float
+	void allocate(int srcW, int srcH, int w, int h, GLint internalFormat, DownsampleFilter f) {
+
+		width = w;
+		height = h;
+		filter = f;
+
+		vector<pair<int, int>> sizes;
+		int pw = srcW, ph = srcH;
+
+		while (pw > w * 2 || ph > h * 2) {
+			pw = max(w, pw / 2);
+			ph = max(h, ph / 2);
+			sizes.push_back(make_pair(pw, ph));
+		}
+
+		sizes.push_back(make_pair(w, h));
+
+		passes.clear();
+		passes.resize(sizes.size());
+
+		for (int i = 0; i < sizes.size(); i++) {
+
+			ofFbo::Settings settings;
+			settings.width = sizes[i].first;
+			settings.height = sizes[i].second;
+			settings.internalformat = internalFormat;
+			settings.minFilter = GL_NEAREST;
+			settings.maxFilter = GL_NEAREST;
+
+			passes[i].allocate(settings);
+		}
+	}
+
+	void downsample(ofTexture &source) {
+
+		ofTexture *input = &source;
+
+		for (int i = 0; i < passes.size(); i++) {
+
+			bool last = i == passes.size() - 1;
+			ofFbo &pass = passes[i];
+
+			pass.begin();
+			{
+				shader.begin();
+				shader.setUniformTexture("tex", *input, 0);
+				shader.setUniform2f("srcSize", input->getWidth(), input->getHeight());
+				shader.setUniform2f("dstSize", pass.getWidth(), pass.getHeight());
+				shader.setUniform1i("kernel", last ? filter : DOWNSAMPLE_BOX);
+				shader.setUniform1f("flip", last ? 1.0f : 0.0f);
+
+				ofDrawRectangle(0, 0, pass.getWidth(), pass.getHeight());
+
+				shader.end();
+			}
+			pass.end();
+
+			input = &pass.getTexture();
+		}
+	}
+
+	// Starts copying the last downsampled frame into a pixel buffer object.
+	// `type` is GL_UNSIGNED_BYTE or GL_FLOAT, `channels` 3 or 4.
+	void beginRead(GLenum type, int channels) {
+
+		size_t size = (size_t)width * height * channels * (type == GL_FLOAT ? sizeof(float) : 1);
+
+		if (buffer.size() != size) {
+			buffer.allocate(size, GL_STREAM_READ);
+		}
+
+		readSize = size;
+
+		const ofTextureData &data = passes.back().getTexture().getTextureData();
+
+		glPixelStorei(GL_PACK_ALIGNMENT, 1);
+		buffer.bind(GL_PIXEL_PACK_BUFFER);
+		glBindTexture(data.textureTarget, data.textureID);
+		glGetTexImage(data.textureTarget, 0, channels == 4 ? GL_RGBA : GL_RGB, type, 0);
+		glBindTexture(data.textureTarget, 0);
+		buffer.unbind(GL_PIXEL_PACK_BUFFER);
+		glPixelStorei(GL_PACK_ALIGNMENT, 4);
+	}
+
+	// waits for the copy and moves it into `dst`, already top down
+	void finishRead(void *dst) {
+
+		const void *src = buffer.map(GL_READ_ONLY);
+
+		if (src == NULL) {
+			return;
+		}
+
+		memcpy(dst, src, readSize);
+		buffer.unmap();
+	}
+
+	int getWidth()	{ return width; }
+	int getHeight()	{ return height; }
+
+private:
+
+	static string getFragmentSource() {
+		// texels are fetched at their centers, so the kernels see exact values
+		return R"(
+			#version 120
+
+			uniform sampler2D tex;
+			uniform vec2 srcSize;
+			uniform vec2 dstSize;
+			uniform int kernel;
+			uniform float flip;
+
+			float lanczos(float x) {
+				if (x == 0.0) return 1.0;
+				if (abs(x) >= 2.0) return 0.0;
+				float px = 3.14159265 * x;
+				return 2.0 * sin(px) * sin(px * 0.5) / (px * px);
+			}
+
+			// overlap of the texel starting at `t` with [lo, hi]
+			float coverage(float t, float lo, float hi) {
+				return max(0.0, min(t + 1.0, hi) - max(t, lo));
+			}
+
+			void main() {
+
+				vec2 ratio = srcSize / dstSize;
+
+				// the center of this pixel in source pixels
+				vec2 c = gl_FragCoord.xy * ratio;
+				if (flip > 0.5) {
+					c.y = srcSize.y - c.y;
+				}
+
+				vec2 lo = c - ratio * 0.5, hi = c + ratio * 0.5;
+				vec2 scale = max(ratio, vec2(1.0));
+				vec2 base = floor(c);
+
+				vec4 sum = vec4(0.0);
+				float total = 0.0;
+
+				// the ratio is at most 2, so the Lanczos support is 4 texels each way
+				for (int j = -4; j <= 4; j++) {
+					for (int i = -4; i <= 4; i++) {
+
+						vec2 t = base + vec2(i, j);
+						float w;
+
+						if (kernel == 0) {
+							w = coverage(t.x, lo.x, hi.x) * coverage(t.y, lo.y, hi.y);
+						} else {
+							vec2 d = (t + 0.5 - c) / scale;
+							w = lanczos(d.x) * lanczos(d.y);
+						}
+
+						if (w != 0.0 && t.x >= 0.0 && t.y >= 0.0 && t.x < srcSize.x && t.y < srcSize.y) {
+							sum += w * texture2D(tex, (t + 0.5) / srcSize);
+							total += w;
+						}
+					}
+				}
+
+				// the negative lobes may ring below black
+				gl_FragColor = max(sum / total, vec4(0.0));
+			}
+		)";
+	}
+
+	ofShader		shader;
+	vector<ofFbo>	passes;
+	ofBufferObject	buffer;
+	size_t			readSize = 0;
+
+	int				width = 0;
+	int				height = 0;
+	DownsampleFilter filter = DOWNSAMPLE_LANCZOS;
+};
@@ -0,0 +1,83 @@
+#pragma once
+
+#include "ofMain.h"
+
+#include "RenderEngine.h"
+#include "Hash.h"
+
+#define ESTIMATE_SAMPLE_FRAMES		4
+
+// Predicts how long an export takes by rendering and reading back a few
+// frames spread over the duration, the same work export does per frame. One
+// frame is sampled per update so a heavy shader does not freeze the UI, and
+// the samples are taken again whenever the shader or the size changes.
+
+class ExportEstimate {
+public:
+
+	// before GLSLManager::update(), which then renders the preview frame again
+	void update(RenderEngine &engine) {
+
+		uint64_t key = engine.getShaderHash();
+		key = Hash::combine(key, (int)engine.getWidth());
+		key = Hash::combine(key, (int)engine.getHeight());
+		key = Hash::combine(key, engine.getFormat());
+		key = Hash::combine(key, engine.getDuration());
+
+		if (key != sampledKey) {
+			sampledKey = key;
+			samples.clear();
+			warmedUp = false;
+		}
+
+		if (!engine.isCompiled() || isReady()) {
+			return;
+		}
+
+		int frame = engine.getDuration() * samples.size() / ESTIMATE_SAMPLE_FRAMES;
+
+		uint64_t start = ofGetElapsedTimeMicros();
+
+		// reading back waits for the GPU to finish the frame
+		if (engine.isFloatTarget()) {
+			engine.readToPixelsAtFrame(frame, floatPixels);
+		} else {
+			engine.readToPixelsAtFrame(frame, pixels);
+		}
+
+		float ms = (ofGetElapsedTimeMicros() - start) / 1000.0f;
+
+		// the first render after a change also pays for the driver's compile
+		if (warmedUp) {
+			samples.push_back(ms);
+		}
+		warmedUp = true;
+	}
+
+	bool isReady() {
+		return samples.size() >= ESTIMATE_SAMPLE_FRAMES;
+	}
+
+	// ms
+	float getFrameTime() {
+		return samples.empty() ? 0 : accumulate(samples.begin(), samples.end(), 0.0f) / samples.size();
+	}
+
+	float getMaxFrameTime() {
+		return samples.empty() ? 0 : *max_element(samples.begin(), samples.end());
+	}
+
+	// seconds to render `frames` frames
+	float getEta(int frames) {
+		return getFrameTime() * frames / 1000.0f;
+	}
+
+private:
+
+	uint64_t		sampledKey = 0;
+	bool			warmedUp = false;
+	vector<float>	samples;
+
+	ofPixels		pixels;
+	ofFloatPixels	floatPixels;
+};
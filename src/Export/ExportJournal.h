@@ -0,0 +1,233 @@
+#pragma once
+
+#include <mutex>
+#include "ofMain.h"
+#include "ofxXmlSettings.h"
+
+#include "Config.h"
+#include "Hash.h"
+#include "Shell.h"
+
+#define EXPORT_SEGMENT_FRAMES	250
+
+// Everything that has to be identical for frames of a previous run to be
+// reused. Written at the head of the journal.
+struct ExportSettings {
+	uint64_t	contentHash = 0;	// RenderEngine::getContentHash(), 0 never resumes
+	int			width = 0;
+	int			height = 0;
+	int			frameRate = 0;
+	int			duration = 0;
+	int			format = 0;
+	string		codec;
+	string		pixelFormat;
+	int			bitrate = 0;
+
+	bool operator==(const ExportSettings &o) const {
+		return contentHash == o.contentHash && width == o.width && height == o.height &&
+			frameRate == o.frameRate && duration == o.duration && format == o.format &&
+			codec == o.codec && pixelFormat == o.pixelFormat && bitrate == o.bitrate;
+	}
+};
+
+// Export is written in closed segments of EXPORT_SEGMENT_FRAMES frames, and
+// every finished segment is recorded in <output>.journal.xml next to the
+// output. If the app dies in the middle, the next export to the same path
+// with the same settings picks up after the last completed segment. Once all
+// frames are there the segments are stitched into the output without
+// re-encoding.
+
+class ExportJournal {
+public:
+
+	// loads the journal for `path` if it was written with the same settings,
+	// otherwise starts a new one. Returns the first frame that needs rendering.
+	int begin(string path, const ExportSettings &s) {
+
+		lock_guard<mutex> lock(mtx);
+
+		outputPath = path;
+		settings = s;
+		segments.clear();
+
+		ofxXmlSettings xml;
+
+		// without a content hash the inputs are unknown, nothing can be reused
+		if (settings.contentHash != 0 && xml.loadFile(getJournalPath()) && xml.pushTag("journal")) {
+
+			ExportSettings saved;
+			saved.contentHash	= Hash::fromHex(xml.getValue("contentHash", ""));
+			saved.width			= xml.getValue("width", 0);
+			saved.height		= xml.getValue("height", 0);
+			saved.frameRate		= xml.getValue("frameRate", 0);
+			saved.duration		= xml.getValue("duration", 0);
+			saved.format		= xml.getValue("format", 0);
+			saved.codec			= xml.getValue("codec", "");
+			saved.pixelFormat	= xml.getValue("pixelFormat", "");
+			saved.bitrate		= xml.getValue("bitrate", 0);
+
+			if (saved == settings) {
+
+				int num = xml.getNumTags("segment");
+
+				for (int i = 0; i < num; i++) {
+					int start = xml.getAttribute("segment", "start", 0, i);
+					int end = xml.getAttribute("segment", "end", 0, i);
+
+					// only a contiguous run from the first frame is usable
+					if (start == getResumeFrameUnlocked()) {
+						segments.push_back(make_pair(start, end));
+					}
+				}
+			}
+
+			xml.popTag();
+		}
+
+		if (segments.empty()) {
+			ofDirectory::removeDirectory(getSegmentDirectory(), true, false);
+		} else {
+			ofLogNotice("ExportJournal") << "Resuming " << outputPath << " from frame " << getResumeFrameUnlocked();
+		}
+
+		ofDirectory::createDirectory(getSegmentDirectory(), false, true);
+
+		save();
+
+		return getResumeFrameUnlocked();
+	}
+
+	// muxed in when the segments are stitched, so segments stay video only
+	void setAudioPath(string path) {
+		lock_guard<mutex> lock(mtx);
+		audioPath = path;
+	}
+
+	// called once a segment is closed and safely on disk
+	void addSegment(int start, int end) {
+		lock_guard<mutex> lock(mtx);
+		segments.push_back(make_pair(start, end));
+		save();
+	}
+
+	// forgets the segments past `frame`, so outputs written side by side
+	// resume together from the one that got the least far
+	void rewind(int frame) {
+		lock_guard<mutex> lock(mtx);
+		while (!segments.empty() && segments.back().second > frame) {
+			ofFile::removeFile(getSegmentPath(segments.back().first), false);
+			segments.pop_back();
+		}
+		save();
+	}
+
+	bool isComplete() {
+		lock_guard<mutex> lock(mtx);
+		return getResumeFrameUnlocked() >= settings.duration;
+	}
+
+	string getSegmentPath(int start) {
+		char name[32];
+		sprintf(name, "segment_%06d.", start);
+		return ofFilePath::join(getSegmentDirectory(), name + ofFilePath::getFileExt(outputPath));
+	}
+
+	// joins the segments into the output with the concat demuxer, adding the
+	// audio if there is any, then removes the segments and the journal
+	bool stitch() {
+
+		lock_guard<mutex> lock(mtx);
+
+		string listPath = ofFilePath::join(getSegmentDirectory(), "segments.txt");
+
+		// the concat demuxer's quoting: a quote ends the string, so it is
+		// written as '\'' like in a shell
+		ofBuffer list;
+		for (auto& segment : segments) {
+			list.append("file '" + ofJoinString(ofSplitString(getSegmentPath(segment.first), "'"), "'\\''") + "'\n");
+		}
+		ofBufferToFile(listPath, list);
+
+		string command = string(FFMPEG_PATH) + " -y -loglevel error -f concat -safe 0" +
+			" -i " + Shell::quote(listPath);
+
+		if (audioPath.empty()) {
+			command += " -c copy";
+		} else {
+			command += " -i " + Shell::quote(audioPath) + " -map 0:v -map 1:a -c:v copy -c:a aac -b:a 320k -shortest";
+		}
+
+		command += " " + Shell::quote(outputPath);
+
+		if (system(command.c_str()) != 0) {
+			ofLogError("ExportJournal") << "Failed to stitch segments, they are kept in " << getSegmentDirectory();
+			return false;
+		}
+
+		removeUnlocked();
+		return true;
+	}
+
+	// image sequences need no stitching, just forget the journal
+	void remove() {
+		lock_guard<mutex> lock(mtx);
+		removeUnlocked();
+	}
+
+private:
+
+	int getResumeFrameUnlocked() {
+		return segments.empty() ? 0 : segments.back().second;
+	}
+
+	void removeUnlocked() {
+		ofDirectory::removeDirectory(getSegmentDirectory(), true, false);
+		ofFile::removeFile(getJournalPath(), false);
+	}
+
+	string getJournalPath() {
+		return outputPath + ".journal.xml";
+	}
+
+	string getSegmentDirectory() {
+		return outputPath + ".segments";
+	}
+
+	void save() {
+
+		ofxXmlSettings xml;
+
+		xml.addTag("journal");
+		xml.pushTag("journal");
+
+		xml.setValue("contentHash", Hash::toHex(settings.contentHash));
+		xml.setValue("width", settings.width);
+		xml.setValue("height", settings.height);
+		xml.setValue("frameRate", settings.frameRate);
+		xml.setValue("duration", settings.duration);
+		xml.setValue("format", settings.format);
+		xml.setValue("codec", settings.codec);
+		xml.setValue("pixelFormat", settings.pixelFormat);
+		xml.setValue("bitrate", settings.bitrate);
+
+		for (int i = 0; i < segments.size(); i++) {
+			xml.addTag("segment");
+			xml.addAttribute("segment", "start", segments[i].first, i);
+			xml.addAttribute("segment", "end", segments[i].second, i);
+		}
+
+		xml.popTag();
+
+		// write next to it and rename, so a crash never leaves a torn journal
+		string tmpPath = getJournalPath() + ".tmp";
+		xml.saveFile(tmpPath);
+		ofFile::moveFromTo(tmpPath, getJournalPath(), false, true);
+	}
+
+	string					outputPath;
+	string					audioPath;
+	ExportSettings			settings;
+	vector<pair<int, int>>	segments;
+
+	mutex					mtx;
+};
@@ -0,0 +1,566 @@
+#pragma once
+
+#include "ofMain.h"
+
+#include "RenderEngine.h"
+#include "FrameEncoder.h"
+#include "ImageSequenceWriter.h"
+#include "ExportJournal.h"
+#include "YUVConverter.h"
+#include "Downsampler.h"
+#include "FrameCache.h"
+#include "Hash.h"
+#include "Trace.h"
+#include "Allocations.h"
+
+enum ExportingStatus {
+	stopped,
+	exporting,
+	saving
+};
+
+struct Codec {
+	string	label;
+	string	name;
+	string	extension;
+	string	pixelFormat;	// raw format piped to ffmpeg
+	bool	isSequence;		// written by ImageSequenceWriter instead of ffmpeg
+};
+
+// One export of a RenderEngine to a file: reads frames back into the pooled
+// buffers and hands them to the encoder or the sequence writer. Used by the
+// app for the Export button and by the render server for every job.
+//
+// A shader with several outputs writes each extra one next to the main file
+// as <basename>_<output>.<ext>, with its own writer, journal and queue.
+// Proxies of the main output are written the same way as
+// <basename>_<w>x<h>.<ext>, downsampled on the GPU. The shader runs once per
+// frame and the extra outputs are read back through pixel buffers while the
+// main one is.
+//
+// With a FrameCache, every output of a frame is looked up before rendering
+// and rendered frames are stored, so exporting the same frames again with
+// another codec or bitrate only encodes.
+
+// the writer of one extra shader output or proxy
+struct ExportOutput {
+	string				name;
+	int					source = 0;			// shader output index
+	bool				scaled = false;		// a proxy, read from downsampler
+	uint64_t			cacheStream = 0;	// FrameCache key of every frame
+	Downsampler			downsampler;
+	ExportJournal		journal;
+	FrameEncoder		encoder;
+	ImageSequenceWriter	sequenceWriter;
+	FrameQueue			*queue = NULL;
+	FrameBuffer			*buffer = NULL;		// acquired for the current frame
+};
+
+class ExportSession {
+public:
+
+	static const vector<Codec>& getCodecs() {
+		static const vector<Codec> codecs = {
+			{"PNG",		"png",		"mov",	"rgb24",	false},
+			{"MPEG4",	"mpeg4",	"mov",	"yuv420p",	false},
+			{"PNG16",	"png16",	"png",	"",			true},
+			{"EXR",		"exr",		"exr",	"",			true}
+		};
+		return codecs;
+	}
+
+	// NULL if there is no codec of that name
+	static const Codec* findCodec(const string &name) {
+		for (auto& codec : getCodecs()) {
+			if (codec.name == name) {
+				return &codec;
+			}
+		}
+		return NULL;
+	}
+
+	bool begin(RenderEngine &renderer, const Codec &c, string path, int bitrate, size_t memoryBudget) {
+
+		if (status != stopped) {
+			return false;
+		}
+
+		engine = &renderer;
+		codec = c;
+
+		int w = engine->getWidth(), h = engine->getHeight();
+		int frameRate = engine->getFrameRate();
+
+		// the buffers are sized for these, see isTargetUnchanged()
+		targetWidth = w;
+		targetHeight = h;
+		targetChannels = engine->getNumChannels();
+		targetFloat = engine->isFloatTarget();
+		targetOutputs = engine->getNumOutputs();
+
+		// even sizes, so every codec takes them
+		vector<pair<int, int>> proxySizes;
+		for (int divisor : proxies) {
+			if (divisor > 1) {
+				proxySizes.push_back(make_pair(max(2, w / divisor & ~1), max(2, h / divisor & ~1)));
+			}
+		}
+
+		// the budget is shared by every output by its size
+		int numOutputs = engine->getNumOutputs();
+		double totalPixels = (double)w * h * numOutputs;
+		for (auto& size : proxySizes) {
+			totalPixels += (double)size.first * size.second;
+		}
+		auto share = [&](int ow, int oh) { return (size_t)(memoryBudget * (ow * oh / totalPixels)); };
+
+		// folds the uniforms that stay the same for every frame, before the
+		// content hash is taken so it names the program that renders
+		engine->beginSpecialized();
+
+		ExportSettings settings;
+		settings.contentHash	= engine->getContentHash();
+		settings.width			= w;
+		settings.height			= h;
+		settings.frameRate		= frameRate;
+		settings.duration		= engine->getDuration();
+		settings.format			= engine->getFormat();
+		settings.codec			= codec.name;
+		settings.bitrate		= bitrate;
+
+		// frames are cached as read back, before any conversion
+		activeCache = frameCache != NULL && engine->getContentHash() != 0 ? frameCache : NULL;
+		cacheStream = getCacheStream(engine->getOutputName(0), false);
+		cacheHits = 0;
+
+		if (activeCache) {
+			activeCache->open((size_t)w * h * engine->getNumChannels() * (codec.isSequence ? sizeof(float) : 1));
+		}
+
+		// convert on the GPU when the codec takes YUV, so only 1.5 bytes per pixel
+		// are read back and ffmpeg has nothing left to convert
+		YUVFormat yuvFormat = YUVConverter::fromPixelFormat(codec.pixelFormat, &useYUV);
+		useYUV = useYUV && !codec.isSequence && activeCache == NULL && YUVConverter::canConvert(w, h, yuvFormat);
+
+		// what ffmpeg is fed, float targets read back as RGBA. The journal keeps
+		// this, segments encoded from another input format must not be joined
+		string pixelFormat = codec.isSequence ? "" : useYUV ? codec.pixelFormat : engine->isFloatTarget() ? "rgba" : "rgb24";
+		settings.pixelFormat = pixelFormat;
+
+		// picks up after the last finished segment of an interrupted export
+		currentFrame = journal.begin(path, settings);
+		journal.setAudioPath(codec.isSequence ? "" : engine->getAudioPath());
+
+		if (codec.isSequence) {
+
+			SequenceFormat format = codec.name == "exr" ? SEQUENCE_EXR_HALF : SEQUENCE_PNG16;
+			sequenceWriter.setup(&journal, path, format, w, h, engine->isFloatTarget() ? 4 : 3, share(w, h));
+			queue = &sequenceWriter.getQueue();
+
+		} else {
+
+			size_t frameSize = (size_t)w * h * (engine->isFloatTarget() ? 4 : 3);
+
+			if (useYUV) {
+				if (!yuvReady) {
+					yuvConverter.setup();
+					yuvReady = true;
+				}
+				yuvConverter.allocate(w, h, yuvFormat);
+				frameSize = (size_t)w * yuvConverter.getRows();
+			}
+
+			if (!encoder.setup(&journal, codec.name, pixelFormat, bitrate, w, h, frameRate, frameSize, share(w, h))) {
+				engine->endSpecialized();
+				return false;
+			}
+			queue = &encoder.getQueue();
+		}
+
+		outputs.clear();
+
+		bool added = true;
+
+		for (int i = 1; i < numOutputs && added; i++) {
+			added = addOutput(engine->getOutputName(i), i, path, settings, w, h, bitrate, share(w, h));
+		}
+
+		for (int i = 0; i < proxySizes.size() && added; i++) {
+			int pw = proxySizes[i].first, ph = proxySizes[i].second;
+			added = addOutput(ofToString(pw) + "x" + ofToString(ph), 0, path, settings, pw, ph, bitrate, share(pw, ph));
+		}
+
+		if (!added) {
+			outputs.clear();
+			encoder.close();
+			sequenceWriter.close();
+			engine->endSpecialized();
+			return false;
+		}
+
+		// every output continues from the same frame
+		if (!outputs.empty()) {
+			journal.rewind(currentFrame);
+			for (auto& output : outputs) {
+				output->journal.rewind(currentFrame);
+			}
+		}
+
+		status = exporting;
+
+		timeInvariant = engine->isTimeInvariant();
+		hasPrevious = false;
+		duplicates = 0;
+
+		if (currentFrame >= engine->getDuration()) {
+			// every segment was already there, only the stitching is left
+			end();
+		}
+
+		return true;
+	}
+
+	// Renders the next frame into a pooled buffer. Returns false without
+	// rendering when the writer is behind and the memory budget is used up,
+	// or when a video input has not decoded the frame yet.
+	bool exportFrame() {
+
+		TRACE_SCOPE("ExportSession::exportFrame");
+		ALLOCATION_SCOPE("ExportSession::exportFrame");
+
+		if (status != exporting) {
+			return false;
+		}
+
+		// reading a resized target into these buffers would write past them
+		if (!isTargetUnchanged()) {
+			ofLogError("ExportSession") << "The render target changed during the export, stopped at frame " << currentFrame;
+			end();
+			return false;
+		}
+
+		// video inputs decode ahead, a frame that is not there yet is retried
+		if (!engine->isFrameReady(currentFrame)) {
+			return false;
+		}
+
+		FrameBuffer *buffer = queue->acquire();
+
+		if (buffer == NULL) {
+			queue->addStall(ofGetLastFrameTime());
+			return false;
+		}
+
+		// a frame goes to every output or to none of them
+		for (auto& output : outputs) {
+
+			output->buffer = output->queue->acquire();
+
+			if (output->buffer == NULL) {
+				output->queue->addStall(ofGetLastFrameTime());
+				releaseBuffers(buffer);
+				return false;
+			}
+		}
+
+		bool skipRender = timeInvariant && hasPrevious;
+
+		buffer->frame = currentFrame;
+		buffer->duplicate = skipRender;
+
+		for (auto& output : outputs) {
+			output->buffer->frame = currentFrame;
+			output->buffer->duplicate = skipRender;
+		}
+
+		// rendered by an earlier export
+		bool render = !skipRender && !readCached(buffer);
+
+		int w = engine->getWidth(), h = engine->getHeight();
+		GLenum outputType = codec.isSequence ? GL_FLOAT : GL_UNSIGNED_BYTE;
+
+		if (render) {
+			engine->renderFrame(currentFrame);
+
+			if (engine->getNumOutputs() > 1) {
+				engine->beginReadOutputs(outputType);
+			}
+
+			for (auto& output : outputs) {
+				if (output->scaled) {
+					output->downsampler.downsample(engine->getTexture(output->source));
+					output->downsampler.beginRead(outputType, engine->getNumChannels());
+				}
+			}
+		}
+
+		if (!render) {
+			// repeated by the writer or already read from the cache
+		} else if (codec.isSequence) {
+			floatPixels.setFromExternalPixels((float*)buffer->data, w, h, engine->getNumChannels());
+			engine->readToPixels(floatPixels);
+		} else if (useYUV) {
+			pixels.setFromExternalPixels(buffer->data, w, yuvConverter.getRows(), 1);
+			yuvConverter.convert(engine->getTexture(), pixels);
+		} else {
+			pixels.setFromExternalPixels(buffer->data, w, h, engine->getNumChannels());
+			engine->readToPixels(pixels);
+		}
+
+		if (render && activeCache) {
+			activeCache->write(Hash::combine(cacheStream, currentFrame), buffer->data, buffer->size);
+		}
+
+		for (int i = 0; i < outputs.size(); i++) {
+
+			FrameBuffer *outputBuffer = outputs[i]->buffer;
+
+			if (!render) {
+				// repeated like the main output, or cached with it
+			} else if (outputs[i]->scaled) {
+				outputs[i]->downsampler.finishRead(outputBuffer->data);
+			} else {
+				engine->finishReadOutput(outputs[i]->source, outputType, outputBuffer->data);
+			}
+
+			if (render && activeCache) {
+				activeCache->write(Hash::combine(outputs[i]->cacheStream, currentFrame), outputBuffer->data, outputBuffer->size);
+			}
+
+			outputs[i]->queue->submit(outputBuffer);
+			outputs[i]->buffer = NULL;
+		}
+
+		if (!buffer->duplicate) {
+			// a shader that holds still is caught by its pixels
+			TRACE_SCOPE("hash");
+			uint64_t hash = Hash::frame(buffer->data, buffer->size);
+			buffer->duplicate = hasPrevious && hash == previousHash;
+			previousHash = hash;
+			hasPrevious = true;
+		}
+
+		if (buffer->duplicate) {
+			duplicates++;
+		}
+
+		queue->submit(buffer);
+
+		if (++currentFrame >= engine->getDuration()) {
+			end();
+		}
+
+		return true;
+	}
+
+	void end() {
+
+		if (status != exporting) {
+			return;
+		}
+
+		engine->endSpecialized();
+
+		if (activeCache) {
+			// the rest of the frames are on disk before the next export looks
+			activeCache->close();
+		}
+
+		ofLogNotice("ExportSession") << "Rendering finished, queue peak " << queue->getPeakDepth() << "/" << queue->getCapacity()
+			<< " frames, stalled " << queue->getStallTime() << "s, " << duplicates << " duplicate frames"
+			<< (timeInvariant ? " (time invariant)" : "") << (activeCache ? ", " + ofToString(cacheHits) + " from the frame cache" : "");
+
+		if (codec.isSequence) {
+			// waits for the remaining frames to be written
+			sequenceWriter.close();
+			for (auto& output : outputs) {
+				output->sequenceWriter.close();
+			}
+			status = stopped;
+			finished = true;
+		} else {
+			encoder.close();
+			for (auto& output : outputs) {
+				output->encoder.close();
+			}
+			status = saving;
+		}
+	}
+
+	// true once, when every output has been finalized
+	bool update() {
+
+		if (status == saving && !isEncoding()) {
+			status = stopped;
+			finished = true;
+		}
+
+		bool result = finished;
+		finished = false;
+		return result;
+	}
+
+	// Downsampled copies of the main output written by the next begin(), one
+	// per divisor of the size, e.g. {2, 4} for a half and a quarter size proxy
+	void setProxies(const vector<int> &divisors, DownsampleFilter filter) {
+		proxies = divisors;
+		proxyFilter = filter;
+	}
+
+	// frames are looked up in and written to `cache` from the next begin(),
+	// NULL to always render
+	void setFrameCache(FrameCache *cache) {
+		frameCache = cache;
+	}
+
+	// frames read from the frame cache instead of rendered
+	int getCacheHits()			{ return cacheHits; }
+
+	// frames that were repeated instead of encoded again
+	int getDuplicates()			{ return duplicates; }
+	ExportingStatus getStatus()	{ return status; }
+	int getCurrentFrame()		{ return currentFrame; }
+	FrameQueue* getQueue()		{ return queue; }
+
+private:
+
+	// an extra output written next to `path` as <basename>_<name>.<ext>,
+	// downsampled when its size is not the render size
+	bool addOutput(const string &name, int source, const string &path, ExportSettings settings, int w, int h, int bitrate, size_t memoryBudget) {
+
+		auto output = unique_ptr<ExportOutput>(new ExportOutput());
+		output->name = name;
+		output->source = source;
+		output->scaled = w != engine->getWidth() || h != engine->getHeight();
+
+		string outputPath = ofFilePath::join(ofFilePath::getEnclosingDirectory(path, false),
+			ofFilePath::getBaseName(path) + "_" + name + "." + ofFilePath::getFileExt(path));
+
+		output->cacheStream = getCacheStream(name, output->scaled);
+
+		int channels = engine->getNumChannels();
+
+		// read back as is, no YUV pass for the extra outputs
+		string pixelFormat = codec.isSequence ? "" : channels == 4 ? "rgba" : "rgb24";
+
+		settings.width = w;
+		settings.height = h;
+		settings.pixelFormat = pixelFormat;
+		currentFrame = min(currentFrame, output->journal.begin(outputPath, settings));
+
+		if (output->scaled) {
+			output->downsampler.setup();
+			output->downsampler.allocate(engine->getWidth(), engine->getHeight(), w, h,
+				targetFormats[engine->getFormat()].internalFormat, proxyFilter);
+		}
+
+		if (codec.isSequence) {
+
+			SequenceFormat format = codec.name == "exr" ? SEQUENCE_EXR_HALF : SEQUENCE_PNG16;
+			output->sequenceWriter.setup(&output->journal, outputPath, format, w, h, channels, memoryBudget);
+			output->queue = &output->sequenceWriter.getQueue();
+
+		} else {
+
+			if (!output->encoder.setup(&output->journal, codec.name, pixelFormat, bitrate, w, h, engine->getFrameRate(), (size_t)w * h * channels, memoryBudget)) {
+				return false;
+			}
+			output->queue = &output->encoder.getQueue();
+		}
+
+		outputs.push_back(move(output));
+		return true;
+	}
+
+	// the engine still renders what begin() sized the buffers and outputs for
+	bool isTargetUnchanged() {
+		return engine->getWidth() == targetWidth && engine->getHeight() == targetHeight &&
+			engine->getNumChannels() == targetChannels && engine->isFloatTarget() == targetFloat &&
+			engine->getNumOutputs() == targetOutputs;
+	}
+
+	// every frame of an output is keyed by this and the frame number
+	uint64_t getCacheStream(const string &name, bool scaled) {
+		uint64_t h = Hash::fnv1a(name, engine->getContentHash());
+		h = Hash::combine(h, codec.isSequence);
+		return Hash::combine(h, scaled ? (int)proxyFilter : -1);
+	}
+
+	// every output of the current frame from the cache, or false to render
+	bool readCached(FrameBuffer *buffer) {
+
+		if (activeCache == NULL || !activeCache->read(Hash::combine(cacheStream, currentFrame), buffer->data, buffer->size)) {
+			return false;
+		}
+
+		for (auto& output : outputs) {
+			if (!activeCache->read(Hash::combine(output->cacheStream, currentFrame), output->buffer->data, output->buffer->size)) {
+				return false;
+			}
+		}
+
+		cacheHits++;
+		return true;
+	}
+
+	bool isEncoding() {
+		for (auto& output : outputs) {
+			if (output->encoder.isEncoding()) {
+				return true;
+			}
+		}
+		return encoder.isEncoding();
+	}
+
+	// hands back what was acquired for a frame that could not be rendered
+	void releaseBuffers(FrameBuffer *buffer) {
+		queue->release(buffer);
+		for (auto& output : outputs) {
+			if (output->buffer != NULL) {
+				output->queue->release(output->buffer);
+				output->buffer = NULL;
+			}
+		}
+	}
+
+	RenderEngine			*engine = NULL;
+	Codec					codec;
+
+	FrameEncoder			encoder;
+	ImageSequenceWriter		sequenceWriter;
+	ExportJournal			journal;
+	FrameQueue				*queue = NULL;
+
+	vector<unique_ptr<ExportOutput>>	outputs;	// shader outputs 1 and up, then proxies
+
+	vector<int>				proxies;
+	DownsampleFilter		proxyFilter = DOWNSAMPLE_LANCZOS;
+
+	FrameCache				*frameCache = NULL;
+	FrameCache				*activeCache = NULL;	// NULL when this export cannot be cached
+	uint64_t				cacheStream = 0;		// of the main output
+	int						cacheHits = 0;
+
+	// views into the buffers of queue
+	ofPixels				pixels;
+	ofFloatPixels			floatPixels;
+
+	YUVConverter			yuvConverter;
+	bool					useYUV = false;
+	bool					yuvReady = false;
+
+	ExportingStatus			status = stopped;
+	bool					finished = false;
+	int						currentFrame = 0;
+
+	int						targetWidth = 0;
+	int						targetHeight = 0;
+	int						targetChannels = 0;
+	bool					targetFloat = false;
+	int						targetOutputs = 0;
+
+	bool					timeInvariant = false;
+	bool					hasPrevious = false;
+	uint64_t				previousHash = 0;
+	int						duplicates = 0;
+};
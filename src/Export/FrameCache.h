@@ -0,0 +1,252 @@
+#pragma once
+
+#include <thread>
+#include <mutex>
+#include <unordered_map>
+#include "ofMain.h"
+
+#include "FrameQueue.h"
+#include "MappedFile.h"
+#include "Hash.h"
+#include "Trace.h"
+
+#define FRAME_CACHE_DIR			ofToDataPath("frame-cache")
+#define FRAME_CACHE_VERSION		1
+#define FRAME_CACHE_QUEUE		(256 * 1024 * 1024)		// bytes of frames waiting to be written
+
+// Lossless store of rendered frames in data/frame-cache, one raw file per
+// frame named by the hash of everything that decides its pixels. Export
+// looks frames up before rendering, so exporting again with another codec,
+// bitrate or duration maps them back in instead. Frames are written by a
+// thread of their own and skipped while it is behind, and the least
+// recently used are deleted once the cache is over its size limit.
+
+class FrameCache {
+public:
+
+	~FrameCache() {
+		close();
+	}
+
+	// `frameSize` is the largest frame that will be written
+	void open(size_t frameSize) {
+
+		close();
+
+		{
+			lock_guard<mutex> lock(mtx);
+			scan();
+			evict();
+		}
+
+		queue.allocate(frameSize, FRAME_CACHE_QUEUE);
+		dropped = 0;
+
+		thread = std::thread(&FrameCache::threadedFunction, this);
+	}
+
+	// blocks until every queued frame is written
+	void close() {
+
+		if (!thread.joinable()) {
+			return;
+		}
+
+		queue.finish();
+		thread.join();
+	}
+
+	// copies a cached frame of `length` bytes into `dst`
+	bool read(uint64_t key, void *dst, size_t length) {
+
+		TRACE_SCOPE("FrameCache::read");
+
+		key = Hash::combine(key, FRAME_CACHE_VERSION);
+
+		if (!contains(key, length) || !mapped.open(getPath(key)) || mapped.size() != length) {
+			return false;
+		}
+
+		memcpy(dst, mapped.getData(), length);
+		mapped.close();
+
+		lock_guard<mutex> lock(mtx);
+		auto it = entries.find(key);
+		if (it != entries.end()) {
+			it->second.lastUse = ++useCount;
+		}
+		return true;
+	}
+
+	// queues a copy for the writer thread, dropped when it is behind
+	void write(uint64_t key, const void *data, size_t length) {
+
+		key = Hash::combine(key, FRAME_CACHE_VERSION);
+
+		if (!thread.joinable() || contains(key, length)) {
+			return;
+		}
+
+		FrameBuffer *buffer = queue.acquire();
+
+		if (buffer == NULL) {
+			dropped++;
+			return;
+		}
+
+		buffer->key = key;
+		buffer->length = min(length, buffer->size);
+		memcpy(buffer->data, data, buffer->length);
+
+		queue.submit(buffer);
+	}
+
+	// deletes every cached frame
+	void clear() {
+
+		lock_guard<mutex> lock(mtx);
+		scan();
+
+		for (auto& iter : entries) {
+			ofFile::removeFile(getPath(iter.first), false);
+		}
+
+		entries.clear();
+		totalSize = 0;
+	}
+
+	// bytes kept on disk, the least recently used frames go first
+	void setLimit(size_t bytes) {
+		lock_guard<mutex> lock(mtx);
+		sizeLimit = bytes;
+		evict();
+	}
+
+	size_t getSize() {
+		lock_guard<mutex> lock(mtx);
+		return totalSize;
+	}
+
+	int getNumFrames() {
+		lock_guard<mutex> lock(mtx);
+		return entries.size();
+	}
+
+	// frames not written because the writer was behind
+	int getDropped()	{ return dropped; }
+
+private:
+
+	struct Entry {
+		size_t		length;
+		uint64_t	lastUse;
+	};
+
+	static string getPath(uint64_t key) {
+		return ofFilePath::join(FRAME_CACHE_DIR, Hash::toHex(key) + ".raw");
+	}
+
+	bool contains(uint64_t key, size_t length) {
+		lock_guard<mutex> lock(mtx);
+		auto it = entries.find(key);
+		return it != entries.end() && it->second.length == length;
+	}
+
+	// frames of earlier sessions, in the order they were written
+	void scan() {
+
+		if (scanned) {
+			return;
+		}
+		scanned = true;
+
+		ofDirectory::createDirectory(FRAME_CACHE_DIR, false, true);
+
+		vector<pair<time_t, pair<uint64_t, size_t>>> files;
+
+		for (filesystem::directory_iterator it(FRAME_CACHE_DIR), end; it != end; ++it) {
+
+			const filesystem::path &p = it->path();
+
+			if (p.extension().string() != ".raw") {
+				continue;
+			}
+
+			files.push_back(make_pair(filesystem::last_write_time(p), make_pair(Hash::fromHex(p.stem().string()), filesystem::file_size(p))));
+		}
+
+		sort(files.begin(), files.end());
+
+		for (auto& file : files) {
+			entries[file.second.first] = {file.second.second, ++useCount};
+			totalSize += file.second.second;
+		}
+	}
+
+	void evict() {
+
+		while (totalSize > sizeLimit && !entries.empty()) {
+
+			auto oldest = entries.begin();
+			for (auto it = entries.begin(); it != entries.end(); ++it) {
+				if (it->second.lastUse < oldest->second.lastUse) {
+					oldest = it;
+				}
+			}
+
+			ofFile::removeFile(getPath(oldest->first), false);
+			totalSize -= oldest->second.length;
+			entries.erase(oldest);
+		}
+	}
+
+	void threadedFunction() {
+
+		Trace::setThreadName("FrameCache");
+
+		while (FrameBuffer *buffer = queue.pop()) {
+
+			TRACE_SCOPE("FrameCache::write");
+
+			string path = getPath(buffer->key);
+			string tmpPath = path + ".tmp";
+
+			bool written;
+			{
+				ofstream out(tmpPath, ios::binary);
+				out.write((const char*)buffer->data, buffer->length);
+				written = (bool)out;
+			}
+
+			// renamed into place, so a reader never maps a partial frame
+			if (written && ofFile::moveFromTo(tmpPath, path, false, true)) {
+				lock_guard<mutex> lock(mtx);
+				auto it = entries.find(buffer->key);
+				if (it != entries.end()) {
+					totalSize -= it->second.length;
+				}
+				entries[buffer->key] = {buffer->length, ++useCount};
+				totalSize += buffer->length;
+				evict();
+			} else {
+				ofLogError("FrameCache") << "Failed to write " << path;
+				ofFile::removeFile(tmpPath, false);
+			}
+
+			queue.release(buffer);
+		}
+	}
+
+	FrameQueue			queue;
+	std::thread			thread;
+	MappedFile			mapped;
+
+	mutex				mtx;
+	unordered_map<uint64_t, Entry>	entries;
+	uint64_t			useCount = 0;
+	size_t				totalSize = 0;
+	size_t				sizeLimit = (size_t)8 * 1024 * 1024 * 1024;
+	bool				scanned = false;
+
+	int					dropped = 0;
+};
@@ -0,0 +1,177 @@
+#pragma once
+
+#include <thread>
+#include <atomic>
+#include <cstdio>
+#include "ofMain.h"
+
+#include "Config.h"
+#include "FrameQueue.h"
+#include "ExportJournal.h"
+#include "Shell.h"
+#include "Trace.h"
+
+#ifdef TARGET_WIN32
+#define popen(command, mode)	_popen(command, mode "b")
+#define pclose					_pclose
+#endif
+
+// Pipes raw frames into ffmpeg processes, one per journal segment. Frames are
+// handed over through a FrameQueue, so memory stays within the budget and the
+// pixel buffers are recycled instead of being copied for every frame.
+
+class FrameEncoder {
+public:
+
+	~FrameEncoder() {
+		close();
+		if (thread.joinable()) {
+			thread.join();
+		}
+	}
+
+	// Frames are encoded into segments recorded in `journal`, and stitched
+	// into the output once the last one is closed.
+	bool setup(ExportJournal *journal, string codec, string pixelFormat, int bitrate, int w, int h, int frameRate, size_t frameSize, size_t memoryBudget) {
+
+		if (thread.joinable()) {
+			thread.join();
+		}
+
+		this->journal = journal;
+
+		commandArgs = string(" -y -loglevel error") +
+			" -f rawvideo -pix_fmt " + pixelFormat +
+			" -s " + ofToString(w) + "x" + ofToString(h) +
+			" -r " + ofToString(frameRate) +
+			" -i -" +
+			" -vcodec " + codec +
+			" -b:v " + ofToString(bitrate) + "k";
+
+		queue.allocate(frameSize, memoryBudget);
+
+		encoding = true;
+		thread = std::thread(&FrameEncoder::threadedFunction, this);
+
+		return true;
+	}
+
+	// flushes the queue and lets ffmpeg finalize the file in the background
+	void close() {
+		if (encoding) {
+			queue.finish();
+		}
+	}
+
+	bool isEncoding() {
+		return encoding;
+	}
+
+	FrameQueue& getQueue() {
+		return queue;
+	}
+
+private:
+
+	void threadedFunction() {
+
+		// kept out of the pool while duplicates may still repeat it
+		FrameBuffer *buffer, *previous = NULL;
+		int segmentStart = -1, segmentEnd = -1, lastFrame = -1;
+		bool failed = false;
+
+		Trace::setThreadName("FrameEncoder");
+
+		while ((buffer = queue.pop()) != NULL) {
+
+			TRACE_SCOPE("FrameEncoder::write");
+
+			if (buffer->frame >= segmentEnd || buffer->frame != lastFrame + 1) {
+
+				if (pipe) {
+					failed |= !closeSegment(segmentStart, lastFrame + 1);
+				}
+
+				segmentStart = buffer->frame;
+				segmentEnd = (segmentStart / EXPORT_SEGMENT_FRAMES + 1) * EXPORT_SEGMENT_FRAMES;
+
+				failed |= !openSegment(segmentStart);
+			}
+
+			FrameBuffer *source = buffer->duplicate && previous ? previous : buffer;
+
+			if (pipe && fwrite(source->data, 1, source->size, pipe) != source->size) {
+				ofLogError("FrameEncoder") << "Failed to write frame " << buffer->frame;
+			}
+
+			lastFrame = buffer->frame;
+
+			if (source == buffer) {
+				if (previous) {
+					queue.release(previous);
+				}
+				previous = buffer;
+			} else {
+				queue.release(buffer);
+			}
+		}
+
+		if (previous) {
+			queue.release(previous);
+		}
+
+		if (pipe) {
+			failed |= !closeSegment(segmentStart, lastFrame + 1);
+		}
+
+		if (!failed && journal->isComplete()) {
+			TRACE_SCOPE("FrameEncoder::stitch");
+			journal->stitch();
+		}
+
+		encoding = false;
+	}
+
+	bool openSegment(int start) {
+
+		TRACE_SCOPE("FrameEncoder::openSegment");
+
+		string command = string(FFMPEG_PATH) + commandArgs + " " + Shell::quote(journal->getSegmentPath(start));
+
+		ofLogVerbose("FrameEncoder") << command;
+
+		pipe = popen(command.c_str(), "w");
+
+		if (pipe == NULL) {
+			ofLogError("FrameEncoder") << "Failed to launch ffmpeg";
+			return false;
+		}
+		return true;
+	}
+
+	// the segment only counts once ffmpeg has exited cleanly
+	bool closeSegment(int start, int end) {
+
+		TRACE_SCOPE("FrameEncoder::closeSegment");
+
+		int status = pclose(pipe);
+		pipe = NULL;
+
+		if (status != 0) {
+			ofLogError("FrameEncoder") << "ffmpeg failed on the segment starting at frame " << start;
+			return false;
+		}
+
+		journal->addSegment(start, end);
+		return true;
+	}
+
+	FrameQueue		queue;
+
+	ExportJournal	*journal = NULL;
+	string			commandArgs;
+
+	FILE			*pipe = NULL;
+	std::thread		thread;
+	atomic<bool>	encoding {false};
+};
@@ -0,0 +1,166 @@
+#pragma once
+
+#include <mutex>
+#include <condition_variable>
+#include "ofMain.h"
+
+#define FRAME_QUEUE_MIN_FRAMES	2
+#define FRAME_QUEUE_ALIGNMENT	4096
+
+struct FrameBuffer {
+	unsigned char	*data = NULL;
+	size_t			size = 0;
+	int				frame = 0;
+	bool			duplicate = false;	// same as the previous frame, data is not filled
+	uint64_t		key = 0;			// FrameCache entry, with its length
+	size_t			length = 0;
+};
+
+// A fixed pool of page aligned frame buffers shared by the render thread and
+// a writer thread. The number of buffers is derived from a memory budget, and
+// once they are all in flight acquire() fails so that the caller stops
+// rendering until the writer has caught up. Nothing is allocated per frame.
+
+class FrameQueue {
+public:
+
+	~FrameQueue() {
+		deallocate();
+	}
+
+	void allocate(size_t frameSize, size_t budgetBytes) {
+
+		deallocate();
+
+		size_t count = std::max((size_t)FRAME_QUEUE_MIN_FRAMES, budgetBytes / frameSize);
+
+		buffers.resize(count);
+		filled.resize(count);
+		filledHead = 0;
+		filledCount = 0;
+
+		for (auto& buffer : buffers) {
+			buffer.data = alignedAlloc(frameSize);
+			buffer.size = frameSize;
+			freeList.push_back(&buffer);
+		}
+
+		finished = false;
+		peakDepth = 0;
+		stallTime = 0;
+	}
+
+	void deallocate() {
+		for (auto& buffer : buffers) {
+			alignedFree(buffer.data);
+		}
+		buffers.clear();
+		freeList.clear();
+		filled.clear();
+		filledCount = 0;
+	}
+
+	// render thread. NULL when every buffer is in flight
+	FrameBuffer* acquire() {
+		lock_guard<mutex> lock(mtx);
+
+		if (freeList.empty()) {
+			return NULL;
+		}
+
+		FrameBuffer *buffer = freeList.back();
+		freeList.pop_back();
+		return buffer;
+	}
+
+	void submit(FrameBuffer *buffer) {
+		{
+			lock_guard<mutex> lock(mtx);
+			filled[(filledHead + filledCount++) % filled.size()] = buffer;
+			peakDepth = std::max(peakDepth, filledCount);
+		}
+		cond.notify_one();
+	}
+
+	// no more frames will be submitted
+	void finish() {
+		{
+			lock_guard<mutex> lock(mtx);
+			finished = true;
+		}
+		cond.notify_one();
+	}
+
+	// writer thread. Blocks, NULL once finished and drained
+	FrameBuffer* pop() {
+		unique_lock<mutex> lock(mtx);
+		cond.wait(lock, [this] { return finished || filledCount > 0; });
+
+		if (filledCount == 0) {
+			return NULL;
+		}
+
+		FrameBuffer *buffer = filled[filledHead];
+		filledHead = (filledHead + 1) % filled.size();
+		filledCount--;
+		return buffer;
+	}
+
+	void release(FrameBuffer *buffer) {
+		lock_guard<mutex> lock(mtx);
+		freeList.push_back(buffer);
+	}
+
+	// time the render thread waited for a free buffer
+	void addStall(float seconds) {
+		stallTime += seconds;
+	}
+
+	int getDepth() {
+		lock_guard<mutex> lock(mtx);
+		return filledCount;
+	}
+
+	int getPeakDepth()		{ return peakDepth; }
+	int getCapacity()		{ return buffers.size(); }
+	float getStallTime()	{ return stallTime; }
+
+	size_t getMemory() {
+		return buffers.empty() ? 0 : buffers.size() * buffers[0].size;
+	}
+
+private:
+
+	static unsigned char* alignedAlloc(size_t size) {
+#ifdef TARGET_WIN32
+		return (unsigned char*)_aligned_malloc(size, FRAME_QUEUE_ALIGNMENT);
+#else
+		void *ptr = NULL;
+		if (posix_memalign(&ptr, FRAME_QUEUE_ALIGNMENT, size) != 0) {
+			return NULL;
+		}
+		return (unsigned char*)ptr;
+#endif
+	}
+
+	static void alignedFree(unsigned char *ptr) {
+#ifdef TARGET_WIN32
+		_aligned_free(ptr);
+#else
+		free(ptr);
+#endif
+	}
+
+	vector<FrameBuffer>		buffers;
+	vector<FrameBuffer*>	freeList;
+	vector<FrameBuffer*>	filled;			// ring of submitted buffers, in frame order
+	int						filledHead = 0;
+	int						filledCount = 0;
+
+	mutex					mtx;
+	condition_variable		cond;
+	bool					finished = false;
+
+	int						peakDepth = 0;
+	float					stallTime = 0;
+};
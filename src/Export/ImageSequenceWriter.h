@@ -0,0 +1,261 @@
+#pragma once
+
+#include <thread>
+#include <fstream>
+#include "ofMain.h"
+
+#include "PixelConvert.h"
+#include "FrameQueue.h"
+#include "ExportJournal.h"
+#include "Trace.h"
+
+enum SequenceFormat {
+	SEQUENCE_PNG16,
+	SEQUENCE_EXR_HALF
+};
+
+// Writes float frames read back from the render target as a numbered image
+// sequence, converting and saving on a worker thread. Frames come in through
+// a FrameQueue the same way they do for FrameEncoder.
+
+class ImageSequenceWriter {
+public:
+
+	~ImageSequenceWriter() {
+		close();
+	}
+
+	// `path` is the file chosen in the save dialog, frames are written next to
+	// it as <basename>_00000.<ext>
+	void setup(ExportJournal *journal, string path, SequenceFormat fmt, int w, int h, int numChannels, size_t memoryBudget) {
+
+		close();
+
+		this->journal = journal;
+		format = fmt;
+		directory = ofFilePath::getEnclosingDirectory(path, false);
+		baseName = ofFilePath::getBaseName(path);
+
+		width = w;
+		height = h;
+		channels = numChannels;
+
+		queue.allocate((size_t)w * h * channels * sizeof(float), memoryBudget);
+
+		thread = std::thread(&ImageSequenceWriter::threadedFunction, this);
+	}
+
+	// blocks until every queued frame is written
+	void close() {
+
+		if (!thread.joinable()) {
+			return;
+		}
+
+		queue.finish();
+		thread.join();
+	}
+
+	FrameQueue& getQueue() {
+		return queue;
+	}
+
+	string getFramePath(int frame) {
+		char number[16];
+		sprintf(number, "_%05d", frame);
+		return ofFilePath::join(directory, baseName + number + (format == SEQUENCE_EXR_HALF ? ".exr" : ".png"));
+	}
+
+	// Minimal scanline OpenEXR writer: uncompressed, HALF B/G/R channels.
+	// FreeImage would also do this, but converts through its own scalar path.
+	static bool saveExrHalf(const string &path, const ofFloatPixels &pixels, vector<uint16_t> &halfBuffer, vector<uint16_t> &lineBuffer) {
+
+		const int w = pixels.getWidth(), h = pixels.getHeight();
+		const int channels = pixels.getNumChannels();
+
+		halfBuffer.resize((size_t)w * h * channels);
+		PixelConvert::floatToHalf(pixels.getData(), halfBuffer.data(), halfBuffer.size());
+
+		ofstream out(path, ios::binary);
+		if (!out) {
+			return false;
+		}
+
+		auto write32 = [&](int32_t v) { out.write((const char*)&v, 4); };
+		auto writeAttr = [&](const char *name, const char *type, int32_t size) {
+			out.write(name, strlen(name) + 1);
+			out.write(type, strlen(type) + 1);
+			write32(size);
+		};
+
+		// magic and version 2, scanline
+		write32(20000630);
+		write32(2);
+
+		// channels are stored in alphabetical order
+		const char *names[3] = {"B", "G", "R"};
+		const int offsets[3] = {2, 1, 0};
+
+		writeAttr("channels", "chlist", 3 * (2 + 16) + 1);
+		for (int c = 0; c < 3; c++) {
+			out.write(names[c], 2);
+			write32(1);					// HALF
+			write32(0);					// pLinear + reserved
+			write32(1); write32(1);		// sampling
+		}
+		out.put(0);
+
+		writeAttr("compression", "compression", 1);
+		out.put(0);
+
+		writeAttr("dataWindow", "box2i", 16);
+		write32(0); write32(0); write32(w - 1); write32(h - 1);
+
+		writeAttr("displayWindow", "box2i", 16);
+		write32(0); write32(0); write32(w - 1); write32(h - 1);
+
+		writeAttr("lineOrder", "lineOrder", 1);
+		out.put(0);
+
+		float one = 1.0f, zero = 0.0f;
+
+		writeAttr("pixelAspectRatio", "float", 4);
+		out.write((const char*)&one, 4);
+
+		writeAttr("screenWindowCenter", "v2f", 8);
+		out.write((const char*)&zero, 4);
+		out.write((const char*)&zero, 4);
+
+		writeAttr("screenWindowWidth", "float", 4);
+		out.write((const char*)&one, 4);
+
+		out.put(0);
+
+		// offset table, one chunk per scanline
+		const int32_t lineBytes = w * 3 * 2;
+		uint64_t offset = (uint64_t)out.tellp() + (uint64_t)h * 8;
+
+		for (int y = 0; y < h; y++) {
+			out.write((const char*)&offset, 8);
+			offset += 8 + lineBytes;
+		}
+
+		lineBuffer.resize(w * 3);
+
+		for (int y = 0; y < h; y++) {
+
+			const uint16_t *row = halfBuffer.data() + (size_t)y * w * channels;
+
+			for (int c = 0; c < 3; c++) {
+				uint16_t *plane = lineBuffer.data() + c * w;
+				for (int x = 0; x < w; x++) {
+					plane[x] = row[x * channels + offsets[c]];
+				}
+			}
+
+			write32(y);
+			write32(lineBytes);
+			out.write((const char*)lineBuffer.data(), lineBytes);
+		}
+
+		return out.good();
+	}
+
+private:
+
+	void threadedFunction() {
+
+		ofShortPixels shortPixels;
+		ofFloatPixels pixels;
+		vector<uint16_t> halfBuffer, lineBuffer;
+
+		FrameBuffer *buffer;
+		string previousPath;
+		int segmentStart = -1, lastFrame = -1;
+		bool failed = false;
+
+		Trace::setThreadName("ImageSequenceWriter");
+
+		while ((buffer = queue.pop()) != NULL) {
+
+			TRACE_SCOPE("ImageSequenceWriter::write");
+
+			if (buffer->frame != lastFrame + 1) {
+				segmentStart = buffer->frame;
+			}
+
+			pixels.setFromExternalPixels((float*)buffer->data, width, height, channels);
+
+			string path = getFramePath(buffer->frame);
+			bool result;
+
+			if (buffer->duplicate && !previousPath.empty()) {
+
+				// the same file again, without converting or compressing
+				result = ofFile::copyFromTo(previousPath, path, false, true);
+
+			} else if (format == SEQUENCE_EXR_HALF) {
+
+				result = saveExrHalf(path, pixels, halfBuffer, lineBuffer);
+
+			} else {
+
+				const int w = pixels.getWidth(), h = pixels.getHeight();
+				const size_t count = (size_t)w * h * pixels.getNumChannels();
+
+				halfBuffer.resize(count);
+
+				if (shortPixels.getWidth() != w || shortPixels.getHeight() != h) {
+					shortPixels.allocate(w, h, OF_PIXELS_RGB);
+				}
+
+				PixelConvert::floatToUint16(pixels.getData(), halfBuffer.data(), count);
+
+				if (pixels.getNumChannels() == 4) {
+					PixelConvert::rgbaToRgb(halfBuffer.data(), shortPixels.getData(), (size_t)w * h);
+				} else {
+					memcpy(shortPixels.getData(), halfBuffer.data(), count * 2);
+				}
+
+				result = ofSaveImage(shortPixels, path);
+			}
+
+			if (!result) {
+				ofLogError("ImageSequenceWriter") << "Failed to write " << path;
+				failed = true;
+			}
+
+			lastFrame = buffer->frame;
+			previousPath = path;
+
+			// every frame is its own file, the journal just checkpoints progress
+			if (!failed && (lastFrame + 1) % EXPORT_SEGMENT_FRAMES == 0) {
+				journal->addSegment(segmentStart, lastFrame + 1);
+				segmentStart = lastFrame + 1;
+			}
+
+			queue.release(buffer);
+		}
+
+		if (!failed && lastFrame + 1 > segmentStart) {
+			journal->addSegment(segmentStart, lastFrame + 1);
+		}
+
+		if (!failed && journal->isComplete()) {
+			journal->remove();
+		}
+	}
+
+	ExportJournal		*journal = NULL;
+
+	SequenceFormat		format;
+	string				directory;
+	string				baseName;
+
+	int					width = 0;
+	int					height = 0;
+	int					channels = 0;
+
+	FrameQueue			queue;
+	std::thread			thread;
+};
@@ -0,0 +1,172 @@
+#pragma once
+
+#include "ofMain.h"
+
+enum YUVFormat {
+	YUV420P,
+	NV12,
+	YUV422P,
+	YUV444P
+};
+
+// Converts the rendered frame to planar YUV on the GPU, writing every plane
+// into a single channel FBO laid out exactly as ffmpeg expects the raw frame.
+// It also takes care of the vertical flip, so the readback is ready to pipe.
+
+class YUVConverter {
+public:
+
+	// maps an ffmpeg -pix_fmt name, `supported` is false for anything else
+	static YUVFormat fromPixelFormat(const string &name, bool *supported) {
+		*supported = true;
+		if (name == "yuv420p")	return YUV420P;
+		if (name == "nv12")		return NV12;
+		if (name == "yuv422p")	return YUV422P;
+		if (name == "yuv444p")	return YUV444P;
+		*supported = false;
+		return YUV420P;
+	}
+
+	// subsampled formats need even dimensions
+	static bool canConvert(int w, int h, YUVFormat format) {
+		switch (format) {
+			case YUV420P:
+			case NV12:		return w % 2 == 0 && h % 2 == 0;
+			case YUV422P:	return w % 2 == 0;
+			default:		return true;
+		}
+	}
+
+	void setup() {
+		shader.setupShaderFromSource(GL_FRAGMENT_SHADER, getFragmentSource());
+		shader.linkProgram();
+	}
+
+	void allocate(int w, int h, YUVFormat fmt) {
+
+		width = w;
+		height = h;
+		format = fmt;
+
+		int rows;
+
+		switch (format) {
+			case YUV420P:
+			case NV12:		rows = h + h / 2; break;
+			case YUV422P:	rows = h * 2; break;
+			default:		rows = h * 3; break;
+		}
+
+		ofFbo::Settings settings;
+		settings.width = w;
+		settings.height = rows;
+		settings.internalformat = GL_R8;
+		settings.minFilter = GL_NEAREST;
+		settings.maxFilter = GL_NEAREST;
+
+		fbo.allocate(settings);
+	}
+
+	void convert(ofTexture &source, ofPixels &pixels) {
+
+		fbo.begin();
+		{
+			shader.begin();
+			shader.setUniformTexture("tex", source, 0);
+			shader.setUniform2f("size", width, height);
+			shader.setUniform1i("format", format);
+
+			ofDrawRectangle(0, 0, fbo.getWidth(), fbo.getHeight());
+
+			shader.end();
+		}
+		fbo.end();
+
+		fbo.readToPixels(pixels);
+	}
+
+	// all planes are stacked in one single channel image of this height, so a
+	// frame is 1.5 bytes per pixel for 4:2:0 instead of 3 for rgb24
+	int getRows() {
+		return fbo.getHeight();
+	}
+
+private:
+
+	static string getFragmentSource() {
+		// BT.601 limited range, the same matrix swscale uses by default
+		return R"(
+			#version 120
+
+			uniform sampler2D tex;
+			uniform vec2 size;
+			uniform int format;
+
+			// `p` is in pixels from the top left, the source texture is bottom up
+			vec3 fetch(vec2 p) {
+				return texture2D(tex, vec2(p.x / size.x, 1.0 - p.y / size.y)).rgb;
+			}
+
+			float luma(vec3 c) {
+				return (16.0 + dot(c, vec3(65.481, 128.553, 24.966))) / 255.0;
+			}
+
+			float chroma(vec3 c, float plane) {
+				vec3 m = plane < 0.5 ? vec3(-37.797, -74.203, 112.0) : vec3(112.0, -93.786, -18.214);
+				return (128.0 + dot(c, m)) / 255.0;
+			}
+
+			void main() {
+
+				// the readback is bottom up too, so the fbo row is the memory row
+				vec2 p = floor(gl_FragCoord.xy);
+				float w = size.x, h = size.y;
+
+				if (p.y < h) {
+					gl_FragColor = vec4(luma(fetch(p + 0.5)));
+					return;
+				}
+
+				float r = p.y - h;
+				float plane, cx, cy;
+				vec2 sub;
+
+				if (format == 1) {
+					// NV12, interleaved UV rows
+					sub = vec2(2.0);
+					plane = mod(p.x, 2.0);
+					cx = floor(p.x / 2.0);
+					cy = r;
+
+				} else if (format == 3) {
+					sub = vec2(1.0);
+					plane = floor(r / h);
+					cx = p.x;
+					cy = r - plane * h;
+
+				} else {
+					sub = format == 0 ? vec2(2.0) : vec2(2.0, 1.0);
+
+					float cw = w / sub.x, ch = h / sub.y;
+					float i = r * w + p.x;
+
+					plane = floor(i / (cw * ch));
+					i -= plane * cw * ch;
+					cy = floor(i / cw);
+					cx = i - cy * cw;
+				}
+
+				// the center of the block, linear filtering averages it
+				vec2 center = vec2(cx, cy) * sub + sub * 0.5;
+				gl_FragColor = vec4(chroma(fetch(center), plane));
+			}
+		)";
+	}
+
+	ofShader	shader;
+	ofFbo		fbo;
+
+	int			width = 0;
+	int			height = 0;
+	YUVFormat	format = YUV420P;
+};
@@ -3,20 +3,176 @@
 #include "ofMain.h"
 #include "ofxImGui.h"
 
+#include <new>
+
 #include "WindowUtils.h"
+#include "Hash.h"
 
 #define IM_ARRAYSIZE(_ARR)  ((int)(sizeof(_ARR)/sizeof(*_ARR)))
 
+#define FONT_CACHE_PATH		ofToDataPath("font-cache.bin")
+
 namespace ImOf
 {
-	inline void SetFont() {
-		ImGuiIO * io = &ImGui::GetIO();
+	struct FontCacheHeader {
+		uint64_t	key;
+		int32_t		width;
+		int32_t		height;
+		float		whiteU;
+		float		whiteV;
+		int32_t		numFonts;
+	};
+	
+	struct FontCacheFont {
+		float		size;
+		float		ascent;
+		float		descent;
+		float		offsetX;
+		float		offsetY;
+		int32_t		numGlyphs;
+	};
+	
+	// Fills the atlas from the cache file, as if it had been built. Nothing is
+	// touched unless the whole file is valid for `key`.
+	inline bool LoadFontCache(ImFontAtlas *atlas, uint64_t key) {
+		
+		ofBuffer buffer = ofBufferFromFile(FONT_CACHE_PATH, true);
+		const char *p = buffer.getData(), *end = p + buffer.size();
+		
+		FontCacheHeader header;
+		if (buffer.size() < sizeof(header)) {
+			return false;
+		}
+		memcpy(&header, p, sizeof(header));
+		p += sizeof(header);
+		
+		if (header.key != key || header.numFonts <= 0) {
+			return false;
+		}
+		
+		vector<FontCacheFont> fonts(header.numFonts);
+		vector<const char*> glyphs(header.numFonts);
+		
+		for (int i = 0; i < header.numFonts; i++) {
+			if (end - p < (ptrdiff_t)sizeof(FontCacheFont)) {
+				return false;
+			}
+			memcpy(&fonts[i], p, sizeof(FontCacheFont));
+			p += sizeof(FontCacheFont);
+			
+			glyphs[i] = p;
+			p += (size_t)fonts[i].numGlyphs * sizeof(ImFont::Glyph);
+		}
+		
+		size_t pixelCount = (size_t)header.width * header.height;
+		if (p > end || (size_t)(end - p) != pixelCount) {
+			return false;
+		}
+		
+		atlas->TexWidth = header.width;
+		atlas->TexHeight = header.height;
+		atlas->TexUvWhitePixel = ImVec2(header.whiteU, header.whiteV);
+		atlas->TexPixelsAlpha8 = (unsigned char*)ImGui::MemAlloc(pixelCount);
+		memcpy(atlas->TexPixelsAlpha8, p, pixelCount);
+		
+		for (int i = 0; i < header.numFonts; i++) {
+			
+			// released by the atlas like the fonts it builds
+			ImFont *font = new (ImGui::MemAlloc(sizeof(ImFont))) ImFont();
+			font->FontSize = fonts[i].size;
+			font->Ascent = fonts[i].ascent;
+			font->Descent = fonts[i].descent;
+			font->DisplayOffset = ImVec2(fonts[i].offsetX, fonts[i].offsetY);
+			font->ContainerAtlas = atlas;
+			
+			font->Glyphs.resize(fonts[i].numGlyphs);
+			memcpy(font->Glyphs.Data, glyphs[i], (size_t)fonts[i].numGlyphs * sizeof(ImFont::Glyph));
+			font->BuildLookupTable();
+			
+			atlas->Fonts.push_back(font);
+		}
+		
+		return true;
+	}
+	
+	inline void SaveFontCache(ImFontAtlas *atlas, uint64_t key) {
+		
+		FontCacheHeader header;
+		header.key = key;
+		header.width = atlas->TexWidth;
+		header.height = atlas->TexHeight;
+		header.whiteU = atlas->TexUvWhitePixel.x;
+		header.whiteV = atlas->TexUvWhitePixel.y;
+		header.numFonts = atlas->Fonts.Size;
+		
+		ofBuffer buffer;
+		buffer.append((const char*)&header, sizeof(header));
+		
+		for (int i = 0; i < atlas->Fonts.Size; i++) {
+			ImFont *font = atlas->Fonts[i];
+			
+			FontCacheFont info;
+			info.size = font->FontSize;
+			info.ascent = font->Ascent;
+			info.descent = font->Descent;
+			info.offsetX = font->DisplayOffset.x;
+			info.offsetY = font->DisplayOffset.y;
+			info.numGlyphs = font->Glyphs.Size;
+			
+			buffer.append((const char*)&info, sizeof(info));
+			buffer.append((const char*)font->Glyphs.Data, (size_t)font->Glyphs.Size * sizeof(ImFont::Glyph));
+		}
+		
+		buffer.append((const char*)atlas->TexPixelsAlpha8, (size_t)atlas->TexWidth * atlas->TexHeight);
+		
+		ofBufferToFile(FONT_CACHE_PATH, buffer, true);
+	}
+	
+	// Rasterizing the fonts at 4x oversampling is most of the startup, so the
+	// built atlas is kept in data/font-cache.bin under the hash of the font
+	// files and settings. Returns true when it came from the cache.
+	inline bool SetFont() {
+		
+		struct FontSpec {
+			const char	*file;
+			float		size;
+		};
+		
+		static const FontSpec specs[] = {
+			{"Karla-Regular.ttf",		14.f},
+			{"FiraCode-Regular.ttf",	16.f},
+			{"FiraCode-Regular.ttf",	28.f}
+		};
+		
+		ImFontAtlas *atlas = ImGui::GetIO().Fonts;
+		
 		ImFontConfig font_config;
 		font_config.OversampleH = 4;
 		font_config.OversampleV = 4;
-		io->Fonts->AddFontFromFileTTF(&ofToDataPath("Karla-Regular.ttf")[0], 14.f, &font_config);
-		io->Fonts->AddFontFromFileTTF(&ofToDataPath("FiraCode-Regular.ttf")[0], 16.f, &font_config);
-		io->Fonts->AddFontFromFileTTF(&ofToDataPath("FiraCode-Regular.ttf")[0], 28.f, &font_config);
+		
+		uint64_t key = Hash::fnv1a(IMGUI_VERSION);
+		key = Hash::combine(key, font_config.OversampleH);
+		key = Hash::combine(key, font_config.OversampleV);
+		key = Hash::combine(key, sizeof(ImFont::Glyph));
+		
+		for (auto& spec : specs) {
+			ofBuffer file = ofBufferFromFile(ofToDataPath(spec.file), true);
+			key = Hash::fnv1a(file.getData(), file.size(), key);
+			key = Hash::combine(key, spec.size);
+		}
+		
+		if (LoadFontCache(atlas, key)) {
+			return true;
+		}
+		
+		for (auto& spec : specs) {
+			atlas->AddFontFromFileTTF(&ofToDataPath(spec.file)[0], spec.size, &font_config);
+		}
+		
+		atlas->Build();
+		SaveFontCache(atlas, key);
+		
+		return false;
 	}
 	
 	inline void PushMonospaceFont() {
@@ -0,0 +1,276 @@
+#pragma once
+
+#include <cstdio>
+#include <fstream>
+#include "ofMain.h"
+
+#include "Config.h"
+#include "Shell.h"
+#include "Hash.h"
+#include "FFT.h"
+#include "MappedFile.h"
+
+#ifdef TARGET_WIN32
+#ifndef popen
+#define popen(command, mode)	_popen(command, mode "b")
+#define pclose					_pclose
+#endif
+#endif
+
+#define AUDIO_CACHE_DIR			ofToDataPath("audio-cache")
+#define AUDIO_CACHE_VERSION		1
+#define AUDIO_SAMPLE_RATE		44100
+#define AUDIO_FFT_SIZE			2048
+#define AUDIO_BINS				512		// up to ~11kHz, like The Book of Shaders and Shadertoy
+#define AUDIO_SMOOTHING			0.6f
+#define AUDIO_MIN_DB			-100.0f
+#define AUDIO_MAX_DB			-30.0f
+
+// one row of the cache file per video frame, also the texture layout: the
+// spectrum on the first row and the waveform on the second
+struct AudioFrame {
+	float	spectrum[AUDIO_BINS];	// 0-1 over AUDIO_MIN_DB - AUDIO_MAX_DB
+	float	waveform[AUDIO_BINS];	// 0-1, silence at 0.5
+	float	rms;
+	float	bass;		// mean spectrum below 250Hz
+	float	mid;		// 250Hz - 2kHz
+	float	treble;		// above 2kHz
+};
+
+struct AudioCacheHeader {
+	int32_t	version;
+	int32_t	frameRate;
+	int32_t	frames;
+	int32_t	bins;
+};
+
+// A soundtrack bound to a sampler2D. It is decoded by ffmpeg and analysed
+// once per frame rate into data/audio-cache, keyed by the file contents, and
+// the cache is memory mapped so a frame is a lookup whether the renderer is
+// playing, scrubbing or exporting. Besides the texture, `<name>_rms`,
+// `<name>_bass`, `<name>_mid` and `<name>_treble` are set as floats.
+
+class AudioSource {
+public:
+
+	static bool isAudio(const string &location) {
+		static const vector<string> extensions = {"wav", "aif", "aiff", "mp3", "aac", "m4a", "flac", "ogg"};
+		string ext = ofToLower(ofFilePath::getFileExt(location));
+		return find(extensions.begin(), extensions.end(), ext) != extensions.end();
+	}
+
+	bool open(string location, int fps) {
+
+		path = location;
+
+		ofBuffer source = ofBufferFromFile(path, true);
+
+		if (source.size() == 0) {
+			return false;
+		}
+
+		sourceHash = Hash::fnv1a(source.getData(), source.size());
+
+		texture.allocate(AUDIO_BINS, 2, GL_R32F);
+
+		return analyse(fps);
+	}
+
+	// re-analyses when the renderer's frame rate has changed
+	void setFrameRate(int fps) {
+		if (fps != frameRate) {
+			analyse(fps);
+		}
+	}
+
+	// silence before the start and after the end
+	const AudioFrame& getFrame(int frame) {
+
+		static const AudioFrame silence = [] {
+			AudioFrame f;
+			fill(f.spectrum, f.spectrum + AUDIO_BINS, 0.0f);
+			fill(f.waveform, f.waveform + AUDIO_BINS, 0.5f);
+			f.rms = f.bass = f.mid = f.treble = 0;
+			return f;
+		}();
+
+		if (!mapped.isOpen() || frame < 0 || frame >= numFrames) {
+			return silence;
+		}
+
+		return ((const AudioFrame*)(mapped.getData() + sizeof(AudioCacheHeader)))[frame];
+	}
+
+	ofTexture& getTexture(int frame) {
+
+		if (frame != uploadedFrame) {
+			// spectrum and waveform are adjacent, so this is both rows
+			texture.loadData(getFrame(frame).spectrum, AUDIO_BINS, 2, GL_RED);
+			uploadedFrame = frame;
+		}
+
+		return texture;
+	}
+
+	const string& getPath() { return path; }
+	uint64_t getSourceHash() { return sourceHash; }
+
+private:
+
+	bool analyse(int fps) {
+
+		frameRate = fps;
+		uploadedFrame = -1;
+		numFrames = 0;
+		mapped.close();
+
+		uint64_t key = Hash::combine(Hash::combine(sourceHash, fps), AUDIO_CACHE_VERSION);
+		string cachePath = ofFilePath::join(AUDIO_CACHE_DIR, Hash::toHex(key) + ".bin");
+
+		if (!ofFile::doesFileExist(cachePath, false) && !writeCache(cachePath)) {
+			return false;
+		}
+
+		if (!mapped.open(cachePath) || mapped.size() < sizeof(AudioCacheHeader)) {
+			ofLogError("AudioSource") << "Failed to map " << cachePath;
+			return false;
+		}
+
+		const AudioCacheHeader *header = (const AudioCacheHeader*)mapped.getData();
+
+		if (header->version != AUDIO_CACHE_VERSION || header->bins != AUDIO_BINS ||
+			mapped.size() < sizeof(AudioCacheHeader) + header->frames * sizeof(AudioFrame)) {
+			ofLogError("AudioSource") << "Invalid cache " << cachePath;
+			mapped.close();
+			return false;
+		}
+
+		numFrames = header->frames;
+		return true;
+	}
+
+	bool decode(vector<float> &samples) {
+
+		string command = string(FFMPEG_PATH) + " -loglevel error -i " + Shell::quote(path) +
+			" -f f32le -ac 1 -ar " + ofToString(AUDIO_SAMPLE_RATE) + " -";
+
+		FILE *pipe = popen(command.c_str(), "r");
+
+		if (pipe == NULL) {
+			ofLogError("AudioSource") << "Failed to launch ffmpeg";
+			return false;
+		}
+
+		float chunk[4096];
+		size_t n;
+
+		while ((n = fread(chunk, sizeof(float), 4096, pipe)) > 0) {
+			samples.insert(samples.end(), chunk, chunk + n);
+		}
+
+		return pclose(pipe) == 0 && !samples.empty();
+	}
+
+	bool writeCache(const string &cachePath) {
+
+		vector<float> samples;
+
+		if (!decode(samples)) {
+			ofLogError("AudioSource") << "Failed to decode " << path;
+			return false;
+		}
+
+		float samplesPerFrame = AUDIO_SAMPLE_RATE / (float)frameRate;
+
+		AudioCacheHeader header;
+		header.version = AUDIO_CACHE_VERSION;
+		header.frameRate = frameRate;
+		header.frames = ceil(samples.size() / samplesPerFrame);
+		header.bins = AUDIO_BINS;
+
+		ofDirectory::createDirectory(AUDIO_CACHE_DIR, false, true);
+
+		string tmpPath = cachePath + ".tmp";
+		ofstream out(ofToDataPath(tmpPath, true), ios::binary);
+		out.write((const char*)&header, sizeof(header));
+
+		FFT fft;
+		fft.setup(AUDIO_FFT_SIZE);
+
+		vector<float> window(AUDIO_FFT_SIZE), magnitudes(AUDIO_FFT_SIZE / 2), smoothed(AUDIO_BINS, 0.0f);
+
+		// frequency of bin i is i * AUDIO_SAMPLE_RATE / AUDIO_FFT_SIZE
+		int bassEnd = 250 * AUDIO_FFT_SIZE / AUDIO_SAMPLE_RATE;
+		int midEnd = 2000 * AUDIO_FFT_SIZE / AUDIO_SAMPLE_RATE;
+
+		AudioFrame row;
+
+		auto sample = [&](long i) {
+			return i >= 0 && i < (long)samples.size() ? samples[i] : 0.0f;
+		};
+
+		for (int f = 0; f < header.frames; f++) {
+
+			long start = f * samplesPerFrame;
+			long center = start + samplesPerFrame / 2;
+
+			for (int i = 0; i < AUDIO_FFT_SIZE; i++) {
+				window[i] = sample(center - AUDIO_FFT_SIZE / 2 + i);
+			}
+
+			fft.magnitudes(window.data(), magnitudes.data());
+
+			float range = AUDIO_MAX_DB - AUDIO_MIN_DB;
+			float bass = 0, mid = 0, treble = 0;
+
+			for (int i = 0; i < AUDIO_BINS; i++) {
+				// smoothed over time on the magnitude, like a Web Audio AnalyserNode
+				smoothed[i] = AUDIO_SMOOTHING * smoothed[i] + (1 - AUDIO_SMOOTHING) * magnitudes[i];
+
+				float db = 20.0f * log10f(max(smoothed[i], 1e-10f));
+				float v = ofClamp((db - AUDIO_MIN_DB) / range, 0, 1);
+				row.spectrum[i] = v;
+
+				(i < bassEnd ? bass : i < midEnd ? mid : treble) += v;
+			}
+
+			row.bass = bass / bassEnd;
+			row.mid = mid / (midEnd - bassEnd);
+			row.treble = treble / (AUDIO_BINS - midEnd);
+
+			for (int i = 0; i < AUDIO_BINS; i++) {
+				row.waveform[i] = ofClamp(0.5f + 0.5f * sample(center - AUDIO_BINS / 2 + i), 0, 1);
+			}
+
+			double sum = 0;
+			for (long i = start; i < start + (long)samplesPerFrame; i++) {
+				sum += sample(i) * sample(i);
+			}
+			row.rms = sqrt(sum / max(1L, (long)samplesPerFrame));
+
+			out.write((const char*)&row, sizeof(row));
+		}
+
+		out.close();
+
+		if (!out) {
+			ofLogError("AudioSource") << "Failed to write " << cachePath;
+			return false;
+		}
+
+		ofFile::moveFromTo(tmpPath, cachePath, false, true);
+
+		ofLogNotice("AudioSource") << "Analysed " << path << ", " << header.frames << " frames at " << frameRate << "fps";
+		return true;
+	}
+
+	string			path;
+	uint64_t		sourceHash = 0;
+
+	int				frameRate = 0;
+	int				numFrames = 0;
+	MappedFile		mapped;
+
+	ofTexture		texture;
+	int				uploadedFrame = -1;
+};
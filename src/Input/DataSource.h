@@ -0,0 +1,320 @@
+#pragma once
+
+#include <fstream>
+#include "ofMain.h"
+
+#include "Hash.h"
+#include "MappedFile.h"
+#include "Trace.h"
+
+#define DATA_CACHE_DIR			ofToDataPath("data-cache")
+#define DATA_CACHE_VERSION		1
+#define DATA_TEXTURE_WIDTH		1024	// records per texture row
+#define DATA_UPLOAD_BUFFERS		3
+
+// How a data file is cut into frames, from the words after its location:
+//   uniform sampler2D points; // data/points.f32 count=4096 channels=3 fps=60
+struct DataOptions {
+	int		count = 0;		// records per frame, 0 makes the whole file one frame
+	int		channels = 4;	// floats per record in binary files, CSV files use their columns
+	int		fps = 0;		// frames of data per second, 0 is one per rendered frame
+
+	void parse(const string &annotations) {
+		for (auto& word : ofSplitString(annotations, " ", true, true)) {
+			if (word.compare(0, 6, "count=") == 0)			count = max(0, ofToInt(word.substr(6)));
+			else if (word.compare(0, 9, "channels=") == 0)	channels = ofClamp(ofToInt(word.substr(9)), 1, 4);
+			else if (word.compare(0, 4, "fps=") == 0)		fps = max(0, ofToInt(word.substr(4)));
+		}
+	}
+
+	uint64_t hash(uint64_t seed) const {
+		seed = Hash::combine(seed, count);
+		seed = Hash::combine(seed, channels);
+		return Hash::combine(seed, fps);
+	}
+};
+
+struct DataCacheHeader {
+	int32_t	version;
+	int32_t	channels;
+	int64_t	records;
+};
+
+// A binary or CSV file of float records bound to a sampler2D. Binary files
+// (f32, bin) are little endian floats mapped as they are, CSV files are
+// converted once into data/data-cache, keyed by their contents, and mapped
+// from there. Only the records of the frame being rendered are copied, into
+// one of three pixel buffers in turn so the copy never waits on the upload
+// before it, and the next frame's pages are read ahead. Records fill the
+// texture row by row, DATA_TEXTURE_WIDTH to a row, one channel per float.
+// `<name>_count` is set to the records in the frame and `<name>_size` to
+// the texture size. Past the last frame the last one is held.
+
+class DataSource {
+public:
+
+	static bool isData(const string &location) {
+		static const vector<string> extensions = {"f32", "bin", "csv"};
+		string ext = ofToLower(ofFilePath::getFileExt(location));
+		return find(extensions.begin(), extensions.end(), ext) != extensions.end();
+	}
+
+	bool open(string location, const DataOptions &opts) {
+
+		path = location;
+		options = opts;
+		uploadedFrame = -1;
+		mapped.close();
+
+		bool opened = ofToLower(ofFilePath::getFileExt(path)) == "csv" ? openCSV() : openBinary();
+
+		if (!opened) {
+			return false;
+		}
+
+		if (records == 0) {
+			ofLogError("DataSource") << path << " has no records";
+			mapped.close();
+			return false;
+		}
+
+		perFrame = options.count > 0 ? min<int64_t>(options.count, records) : records;
+		numFrames = (records + perFrame - 1) / perFrame;
+
+		width = min<int64_t>(perFrame, DATA_TEXTURE_WIDTH);
+		height = (perFrame + width - 1) / width;
+
+		static const GLint internalFormats[] = {GL_R32F, GL_RG32F, GL_RGB32F, GL_RGBA32F};
+		static const GLint formats[] = {GL_RED, GL_RG, GL_RGB, GL_RGBA};
+		glFormat = formats[channels - 1];
+
+		texture.allocate(width, height, internalFormats[channels - 1], false, glFormat, GL_FLOAT);
+		texture.setTextureMinMagFilter(GL_NEAREST, GL_NEAREST);
+
+		for (auto& buffer : buffers) {
+			buffer.allocate(getUploadSize(), GL_STREAM_DRAW);
+		}
+
+		mapped.prefetch(getFrameOffset(0), getFrameSize(0));
+
+		ofLogNotice("DataSource") << "Mapped " << path << ", " << numFrames << " frames of " << perFrame << " records";
+		return true;
+	}
+
+	ofTexture& getTexture(int frame, int fps) {
+
+		int dataFrame = getDataFrame(frame, fps);
+
+		if (dataFrame != uploadedFrame) {
+			upload(dataFrame);
+			uploadedFrame = dataFrame;
+		}
+
+		return texture;
+	}
+
+	// records in `frame`, the last frame of a file may be short
+	int getCount(int frame, int fps) {
+		int dataFrame = getDataFrame(frame, fps);
+		return min<int64_t>(perFrame, records - (int64_t)dataFrame * perFrame);
+	}
+
+	// one frame for the whole file, the same at any time
+	bool isStatic()		{ return numFrames <= 1; }
+
+	int getWidth()		{ return width; }
+	int getHeight()		{ return height; }
+
+	const string& getPath() { return path; }
+
+	// the file and how it is cut into frames
+	uint64_t getKey() { return options.hash(sourceHash); }
+
+private:
+
+	int getDataFrame(int frame, int fps) {
+		if (options.fps > 0 && fps > 0) {
+			frame = (int64_t)frame * options.fps / fps;
+		}
+		return ofClamp(frame, 0, numFrames - 1);
+	}
+
+	size_t getFrameOffset(int dataFrame) {
+		return (size_t)dataFrame * perFrame * channels * sizeof(float);
+	}
+
+	size_t getFrameSize(int dataFrame) {
+		return (size_t)min<int64_t>(perFrame, records - (int64_t)dataFrame * perFrame) * channels * sizeof(float);
+	}
+
+	size_t getUploadSize() {
+		return (size_t)width * height * channels * sizeof(float);
+	}
+
+	void upload(int dataFrame) {
+
+		TRACE_SCOPE("DataSource::upload");
+
+		// the buffer written now was last uploaded from two frames ago
+		ofBufferObject &buffer = buffers[nextBuffer];
+		nextBuffer = (nextBuffer + 1) % DATA_UPLOAD_BUFFERS;
+
+		char *dst = (char*)buffer.map(GL_WRITE_ONLY);
+
+		if (dst == NULL) {
+			return;
+		}
+
+		size_t size = getFrameSize(dataFrame);
+		memcpy(dst, start + getFrameOffset(dataFrame), size);
+		memset(dst + size, 0, getUploadSize() - size);
+		buffer.unmap();
+
+		texture.loadData(buffer, glFormat, GL_FLOAT);
+
+		// frames are mostly rendered in order
+		if (dataFrame + 1 < numFrames) {
+			mapped.prefetch(getFrameOffset(dataFrame + 1), getFrameSize(dataFrame + 1));
+		}
+	}
+
+	bool openBinary() {
+
+		if (!mapped.open(path)) {
+			ofLogError("DataSource") << "Failed to map " << path;
+			return false;
+		}
+
+		channels = options.channels;
+		records = mapped.size() / (channels * sizeof(float));
+		start = mapped.getData();
+
+		// by location, size and modification time, hashing the contents
+		// would read the whole file before the first frame
+		sourceHash = Hash::fnv1a(path);
+		sourceHash = Hash::combine(sourceHash, (uint64_t)mapped.size());
+		sourceHash = Hash::combine(sourceHash, (int64_t)filesystem::last_write_time(path));
+		return true;
+	}
+
+	bool openCSV() {
+
+		ofBuffer source = ofBufferFromFile(path, false);
+
+		if (source.size() == 0) {
+			return false;
+		}
+
+		sourceHash = Hash::fnv1a(source.getData(), source.size());
+
+		uint64_t key = Hash::combine(sourceHash, DATA_CACHE_VERSION);
+		string cachePath = ofFilePath::join(DATA_CACHE_DIR, Hash::toHex(key) + ".bin");
+
+		if (!ofFile::doesFileExist(cachePath, false) && !writeCache(source, cachePath)) {
+			return false;
+		}
+
+		if (!mapped.open(cachePath) || mapped.size() < sizeof(DataCacheHeader)) {
+			ofLogError("DataSource") << "Failed to map " << cachePath;
+			return false;
+		}
+
+		const DataCacheHeader *header = (const DataCacheHeader*)mapped.getData();
+
+		if (header->version != DATA_CACHE_VERSION || header->channels < 1 || header->channels > 4 ||
+			mapped.size() < sizeof(DataCacheHeader) + header->records * header->channels * sizeof(float)) {
+			ofLogError("DataSource") << "Invalid cache " << cachePath;
+			mapped.close();
+			return false;
+		}
+
+		channels = header->channels;
+		records = header->records;
+		start = mapped.getData() + sizeof(DataCacheHeader);
+		return true;
+	}
+
+	// one record per row and one channel per column, up to four, rows that
+	// are not numbers like a header are skipped
+	bool writeCache(const ofBuffer &source, const string &cachePath) {
+
+		vector<float> values;
+		int columns = 0;
+
+		for (auto& line : source.getLines()) {
+
+			vector<string> cells = ofSplitString(line, ",", false, true);
+
+			if (cells.empty() || cells[0].empty()) {
+				continue;
+			}
+
+			float row[4] = {0, 0, 0, 0};
+			bool numeric = true;
+
+			for (int i = 0; i < cells.size() && i < 4; i++) {
+				char *end;
+				row[i] = strtof(cells[i].c_str(), &end);
+				numeric = numeric && end != cells[i].c_str();
+			}
+
+			if (!numeric) {
+				continue;
+			}
+
+			if (columns == 0) {
+				columns = min<int>(cells.size(), 4);
+			}
+
+			values.insert(values.end(), row, row + columns);
+		}
+
+		if (values.empty()) {
+			ofLogError("DataSource") << "No numeric rows in " << path;
+			return false;
+		}
+
+		DataCacheHeader header;
+		header.version = DATA_CACHE_VERSION;
+		header.channels = columns;
+		header.records = values.size() / columns;
+
+		ofDirectory::createDirectory(DATA_CACHE_DIR, false, true);
+
+		string tmpPath = cachePath + ".tmp";
+		ofstream out(ofToDataPath(tmpPath, true), ios::binary);
+		out.write((const char*)&header, sizeof(header));
+		out.write((const char*)values.data(), values.size() * sizeof(float));
+		out.close();
+
+		if (!out) {
+			ofLogError("DataSource") << "Failed to write " << cachePath;
+			return false;
+		}
+
+		ofFile::moveFromTo(tmpPath, cachePath, false, true);
+
+		ofLogNotice("DataSource") << "Converted " << path << ", " << header.records << " records of " << columns << " columns";
+		return true;
+	}
+
+	string			path;
+	DataOptions		options;
+	uint64_t		sourceHash = 0;
+
+	MappedFile		mapped;
+	const char		*start = NULL;	// the first record
+	int				channels = 4;
+	int64_t			records = 0;
+	int64_t			perFrame = 0;
+	int				numFrames = 0;
+
+	ofTexture		texture;
+	int				width = 0;
+	int				height = 0;
+	GLint			glFormat = GL_RGBA;
+
+	ofBufferObject	buffers[DATA_UPLOAD_BUFFERS];
+	int				nextBuffer = 0;
+	int				uploadedFrame = -1;
+};
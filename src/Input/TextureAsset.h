@@ -0,0 +1,332 @@
+#pragma once
+
+#include "ofMain.h"
+
+#include "Hash.h"
+
+#define TEXTURE_CACHE_DIR		ofToDataPath("texture-cache")
+#define TEXTURE_CACHE_VERSION	1
+
+#ifndef GL_COMPRESSED_RGBA_BPTC_UNORM
+#define GL_COMPRESSED_RGBA_BPTC_UNORM	0x8E8C
+#endif
+
+// How a texture is ingested, from the words after its location:
+//   uniform sampler2D tex; // image.png compress max=1024 nomipmap
+struct TextureOptions {
+	bool	mipmap = true;
+	bool	compress = false;
+	int		maxSize = 0;	// longest side, 0 keeps the source size
+
+	void parse(const string &annotations) {
+		for (auto& word : ofSplitString(annotations, " ", true, true)) {
+			if (word == "mipmap")			mipmap = true;
+			else if (word == "nomipmap")	mipmap = false;
+			else if (word == "compress")	compress = true;
+			else if (word == "nocompress")	compress = false;
+			else if (word.compare(0, 4, "max=") == 0)	maxSize = ofToInt(word.substr(4));
+		}
+	}
+
+	uint64_t hash(uint64_t seed) const {
+		seed = Hash::combine(seed, mipmap);
+		seed = Hash::combine(seed, compress);
+		return Hash::combine(seed, maxSize);
+	}
+};
+
+struct TextureLevel {
+	int		width;
+	int		height;
+	size_t	offset;		// into the cache file
+	size_t	size;
+};
+
+// A still image turned into the texture the shader samples: downscaled to
+// maxSize, with a mip chain generated on the GPU and optionally compressed by
+// the driver (BC7, or DXT1/DXT5 without BPTC support). Every level is read
+// back and written to data/texture-cache under the hash of the source bytes
+// and the options, so the next load only uploads them. The top levels can be
+// left out on upload to fit a memory budget without ingesting again.
+
+class TextureAsset {
+public:
+
+	~TextureAsset() {
+		if (textureId != 0) {
+			glDeleteTextures(1, &textureId);
+		}
+	}
+
+	bool load(const ofBuffer &source, const TextureOptions &opts) {
+
+		options = opts;
+
+		key = Hash::fnv1a(source.getData(), source.size());
+		key = Hash::combine(options.hash(key), TEXTURE_CACHE_VERSION);
+
+		cachePath = ofFilePath::join(TEXTURE_CACHE_DIR, Hash::toHex(key) + ".tex");
+
+		if (!readCache() && !(ingest(source) && readCache())) {
+			return false;
+		}
+
+		uploadedSkip = -1;
+		return true;
+	}
+
+	// skips the first `skip` levels, so the base is 2^skip times smaller
+	void upload(int skip) {
+
+		skip = ofClamp(skip, 0, levels.size() - 1);
+
+		if (skip == uploadedSkip) {
+			return;
+		}
+
+		ofBuffer data = ofBufferFromFile(cachePath, true);
+
+		if (data.size() < levels.back().offset + levels.back().size) {
+			ofLogError("TextureAsset") << "Cache file is truncated: " << cachePath;
+			return;
+		}
+
+		if (textureId == 0) {
+			glGenTextures(1, &textureId);
+		}
+
+		glBindTexture(GL_TEXTURE_2D, textureId);
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+
+		int count = levels.size() - skip;
+
+		for (int i = 0; i < count; i++) {
+			const TextureLevel &level = levels[skip + i];
+			const char *bytes = data.getData() + level.offset;
+			if (isCompressed()) {
+				glCompressedTexImage2D(GL_TEXTURE_2D, i, internalFormat, level.width, level.height, 0, level.size, bytes);
+			} else {
+				glTexImage2D(GL_TEXTURE_2D, i, internalFormat, level.width, level.height, 0, getPixelFormat(), GL_UNSIGNED_BYTE, bytes);
+			}
+		}
+
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, 0);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, count - 1);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, count > 1 ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+		glBindTexture(GL_TEXTURE_2D, 0);
+
+		// let ofShader bind it like any other texture
+		ofTextureData &texData = texture.getTextureData();
+		texData.textureTarget = GL_TEXTURE_2D;
+		texData.glInternalFormat = internalFormat;
+		texData.width = texData.tex_w = levels[skip].width;
+		texData.height = texData.tex_h = levels[skip].height;
+		texData.tex_t = texData.tex_u = 1;
+		texture.setUseExternalTextureID(textureId);
+
+		uploadedSkip = skip;
+	}
+
+	// bytes on the GPU with the first `skip` levels left out
+	size_t getMemory(int skip) {
+		size_t size = 0;
+		for (int i = ofClamp(skip, 0, levels.size() - 1); i < levels.size(); i++) {
+			size += levels[i].size;
+		}
+		return size;
+	}
+
+	size_t getMemory()			{ return getMemory(uploadedSkip); }
+	int getNumLevels()			{ return levels.size(); }
+	int getSkip()				{ return uploadedSkip; }
+	uint64_t getKey()			{ return key; }		// of the contents and options
+	bool isCompressed()			{ return internalFormat != GL_RGB8 && internalFormat != GL_RGBA8; }
+	ofTexture& getTexture()		{ return texture; }
+
+	// an explicit max= is what the shader asked for, the budget leaves it alone
+	bool isPinned()				{ return options.maxSize > 0; }
+
+	const char* getFormatName() {
+		switch (internalFormat) {
+			case GL_COMPRESSED_RGBA_BPTC_UNORM:		return "BC7";
+			case GL_COMPRESSED_RGB_S3TC_DXT1_EXT:	return "DXT1";
+			case GL_COMPRESSED_RGBA_S3TC_DXT5_EXT:	return "DXT5";
+			case GL_RGBA8:							return "RGBA8";
+			default:								return "RGB8";
+		}
+	}
+
+private:
+
+	GLenum getPixelFormat() {
+		return channels == 4 ? GL_RGBA : GL_RGB;
+	}
+
+	static GLint getCompressedFormat(int channels) {
+		if (ofGLCheckExtension("GL_ARB_texture_compression_bptc")) {
+			return GL_COMPRESSED_RGBA_BPTC_UNORM;
+		}
+		if (ofGLCheckExtension("GL_EXT_texture_compression_s3tc")) {
+			return channels == 4 ? GL_COMPRESSED_RGBA_S3TC_DXT5_EXT : GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+		}
+		return 0;
+	}
+
+	// decode, resize, build mips and compress, then write every level
+	bool ingest(const ofBuffer &source) {
+
+		ofPixels pixels;
+
+		if (!ofLoadImage(pixels, source)) {
+			return false;
+		}
+
+		// gray and gray alpha sample like they did through ofTexture
+		if (pixels.getNumChannels() < 3) {
+			ofPixels expanded;
+			int n = pixels.getNumChannels();
+			expanded.allocate(pixels.getWidth(), pixels.getHeight(), n == 2 ? OF_PIXELS_RGBA : OF_PIXELS_RGB);
+			unsigned char *src = pixels.getData(), *dst = expanded.getData();
+			for (size_t i = 0, count = pixels.getWidth() * pixels.getHeight(); i < count; i++, src += n) {
+				*dst++ = src[0]; *dst++ = src[0]; *dst++ = src[0];
+				if (n == 2) *dst++ = src[1];
+			}
+			pixels = expanded;
+		}
+
+		int longest = max(pixels.getWidth(), pixels.getHeight());
+
+		if (options.maxSize > 0 && longest > options.maxSize) {
+			float scale = options.maxSize / (float)longest;
+			pixels.resize(max(1, (int)(pixels.getWidth() * scale)), max(1, (int)(pixels.getHeight() * scale)), OF_INTERPOLATE_BICUBIC);
+		}
+
+		channels = pixels.getNumChannels();
+
+		GLint compressedFormat = options.compress ? getCompressedFormat(channels) : 0;
+
+		if (options.compress && compressedFormat == 0) {
+			ofLogWarning("TextureAsset") << "No supported texture compression, stored uncompressed";
+		}
+
+		internalFormat = compressedFormat != 0 ? compressedFormat : channels == 4 ? GL_RGBA8 : GL_RGB8;
+
+		int w = pixels.getWidth(), h = pixels.getHeight();
+
+		// mips are filtered on the uncompressed image, then each level is compressed
+		GLuint sourceTex, compressedTex = 0;
+		glGenTextures(1, &sourceTex);
+		glBindTexture(GL_TEXTURE_2D, sourceTex);
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+		glPixelStorei(GL_PACK_ALIGNMENT, 1);
+		glTexImage2D(GL_TEXTURE_2D, 0, channels == 4 ? GL_RGBA8 : GL_RGB8, w, h, 0, getPixelFormat(), GL_UNSIGNED_BYTE, pixels.getData());
+
+		int count = 1;
+		if (options.mipmap) {
+			glGenerateMipmap(GL_TEXTURE_2D);
+			count = 1 + (int)floor(log2(max(w, h)));
+		}
+
+		if (compressedFormat != 0) {
+			glGenTextures(1, &compressedTex);
+		}
+
+		ofBuffer out;
+		vector<char> level;
+		int header[4] = {TEXTURE_CACHE_VERSION, (int)internalFormat, channels, count};
+		out.append((const char*)header, sizeof(header));
+
+		for (int i = 0; i < count; i++) {
+
+			int lw = max(1, w >> i), lh = max(1, h >> i);
+
+			level.resize((size_t)lw * lh * channels);
+			glBindTexture(GL_TEXTURE_2D, sourceTex);
+			glGetTexImage(GL_TEXTURE_2D, i, getPixelFormat(), GL_UNSIGNED_BYTE, level.data());
+
+			if (compressedFormat != 0) {
+				GLint size = 0;
+				glBindTexture(GL_TEXTURE_2D, compressedTex);
+				glTexImage2D(GL_TEXTURE_2D, i, compressedFormat, lw, lh, 0, getPixelFormat(), GL_UNSIGNED_BYTE, level.data());
+				glGetTexLevelParameteriv(GL_TEXTURE_2D, i, GL_TEXTURE_COMPRESSED_IMAGE_SIZE, &size);
+				level.resize(size);
+				glGetCompressedTexImage(GL_TEXTURE_2D, i, level.data());
+			}
+
+			int levelHeader[3] = {lw, lh, (int)level.size()};
+			out.append((const char*)levelHeader, sizeof(levelHeader));
+			out.append(level.data(), level.size());
+		}
+
+		glBindTexture(GL_TEXTURE_2D, 0);
+		glDeleteTextures(1, &sourceTex);
+		if (compressedTex != 0) {
+			glDeleteTextures(1, &compressedTex);
+		}
+
+		ofDirectory::createDirectory(TEXTURE_CACHE_DIR, false, true);
+
+		if (!ofBufferToFile(cachePath, out, true)) {
+			ofLogError("TextureAsset") << "Failed to write " << cachePath;
+			return false;
+		}
+
+		ofLogNotice("TextureAsset") << "Ingested " << w << "x" << h << " " << getFormatName() << ", " << count << " levels";
+		return true;
+	}
+
+	// reads the level table, the pixels are read again on upload
+	bool readCache() {
+
+		levels.clear();
+
+		ofFile file(cachePath, ofFile::ReadOnly, true);
+
+		if (!file.exists()) {
+			return false;
+		}
+
+		int header[4];
+		if (!file.read((char*)header, sizeof(header)) || header[0] != TEXTURE_CACHE_VERSION) {
+			return false;
+		}
+
+		internalFormat = header[1];
+		channels = header[2];
+
+		size_t offset = sizeof(header);
+
+		for (int i = 0; i < header[3]; i++) {
+
+			int levelHeader[3];
+			if (!file.read((char*)levelHeader, sizeof(levelHeader))) {
+				levels.clear();
+				return false;
+			}
+			offset += sizeof(levelHeader);
+
+			levels.push_back((TextureLevel){levelHeader[0], levelHeader[1], offset, (size_t)levelHeader[2]});
+
+			offset += levelHeader[2];
+			file.seekg(offset);
+		}
+
+		return !levels.empty();
+	}
+
+	TextureOptions			options;
+	uint64_t				key = 0;
+	string					cachePath;
+
+	GLint					internalFormat = GL_RGB8;
+	int						channels = 3;
+	vector<TextureLevel>	levels;
+
+	GLuint					textureId = 0;
+	int						uploadedSkip = -1;
+	ofTexture				texture;
+};
@@ -0,0 +1,437 @@
+#pragma once
+
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <regex>
+#include <cstdio>
+#include "ofMain.h"
+
+#include "Config.h"
+#include "Shell.h"
+
+#ifdef TARGET_WIN32
+#ifndef popen
+#define popen(command, mode)	_popen(command, mode "b")
+#define pclose					_pclose
+#endif
+#endif
+
+#define VIDEO_RING_FRAMES		12		// decoded frames kept ahead of the playhead
+#define VIDEO_SKIP_FRAMES		48		// further than this, ffmpeg is restarted with a seek
+
+struct VideoFrame {
+	ofPixels	pixels;
+	int			frame = -1;
+	bool		ready = false;
+	bool		pinned = false;		// being uploaded by the main thread
+};
+
+// A movie or numbered image sequence bound to a sampler2D. A background
+// thread decodes the frames following the requested one into a ring of
+// preallocated buffers, keyed by frame at the renderer's frame rate, and the
+// main thread only streams a ready frame into the texture through a pair of
+// PBOs. Movies are decoded by an ffmpeg pipe, sequences are "name_%04d.png"
+// patterns resolved against the files on disk.
+
+class VideoSource {
+public:
+
+	static bool isVideo(const string &location) {
+		static const vector<string> extensions = {"mov", "mp4", "m4v", "avi", "mkv", "webm"};
+		string ext = ofToLower(ofFilePath::getFileExt(location));
+		return find(extensions.begin(), extensions.end(), ext) != extensions.end() || isSequence(location);
+	}
+
+	static bool isSequence(const string &location) {
+		static regex patternRegex(".*%0?[0-9]*d.*");
+		return regex_match(location, patternRegex);
+	}
+
+	~VideoSource() {
+		close();
+	}
+
+	bool open(string location, int fps) {
+
+		path = location;
+		frameRate = fps;
+
+		ofPixels first;
+
+		if (isSequence(path)) {
+			if (!listSequence() || !ofLoadImage(first, files[0])) {
+				return false;
+			}
+			width = first.getWidth();
+			height = first.getHeight();
+			length = files.size();
+		} else if (!probe()) {
+			return false;
+		}
+
+		for (auto& slot : ring) {
+			slot.pixels.allocate(width, height, OF_PIXELS_RGBA);
+		}
+
+		texture.allocate(width, height, GL_RGBA);
+		for (auto& pbo : pbos) {
+			pbo.allocate(width * height * 4, GL_STREAM_DRAW);
+		}
+
+		running = true;
+		thread = std::thread(&VideoSource::threadedFunction, this);
+
+		return true;
+	}
+
+	void close() {
+
+		{
+			lock_guard<mutex> lock(mtx);
+			running = false;
+		}
+		cv.notify_all();
+
+		if (thread.joinable()) {
+			thread.join();
+		}
+	}
+
+	// Asks for `frame` and the ones after it. Never waits for the decoder.
+	void request(int frame, int fps) {
+
+		lock_guard<mutex> lock(mtx);
+
+		if (fps != frameRate) {
+			// every decoded frame is at the old rate
+			frameRate = fps;
+			if (!isSequence(path)) {
+				length = max(1, (int)(duration * fps));
+			}
+			for (auto& slot : ring) {
+				if (!slot.pinned) {
+					slot.ready = false;
+					slot.frame = -1;
+				}
+			}
+		}
+
+		requested = clampFrame(frame);
+		cv.notify_all();
+	}
+
+	bool isFrameReady(int frame) {
+		lock_guard<mutex> lock(mtx);
+		return findSlot(clampFrame(frame)) != NULL;
+	}
+
+	// Uploads `frame` if it has been decoded, otherwise the texture keeps the
+	// last uploaded one
+	ofTexture& getTexture(int frame) {
+
+		VideoFrame *slot;
+		{
+			lock_guard<mutex> lock(mtx);
+			frame = clampFrame(frame);
+			slot = frame != uploadedFrame ? findSlot(frame) : NULL;
+			if (slot == NULL) {
+				return texture;
+			}
+			slot->pinned = true;
+		}
+
+		// fill one PBO while the driver may still be reading the other
+		ofBufferObject &pbo = pbos[pboIndex];
+		pboIndex = 1 - pboIndex;
+
+		void *dst = pbo.map(GL_WRITE_ONLY);
+		if (dst != NULL) {
+			memcpy(dst, slot->pixels.getData(), slot->pixels.size());
+			pbo.unmap();
+			texture.loadData(pbo, GL_RGBA, GL_UNSIGNED_BYTE);
+			uploadedFrame = frame;
+		}
+
+		{
+			lock_guard<mutex> lock(mtx);
+			slot->pinned = false;
+		}
+		cv.notify_all();
+
+		return texture;
+	}
+
+	int getWidth()	{ return width; }
+	int getHeight()	{ return height; }
+
+private:
+
+	// movies hold their last frame once they run out
+	int clampFrame(int frame) {
+		return ofClamp(frame, 0, max(0, length - 1));
+	}
+
+	VideoFrame* findSlot(int frame) {
+		for (auto& slot : ring) {
+			if (slot.ready && slot.frame == frame) {
+				return &slot;
+			}
+		}
+		return NULL;
+	}
+
+	bool listSequence() {
+
+		// "shots/frame_%04d.png" matches shots/frame_0001.png, frame_0002.png, ...
+		string pattern = ofFilePath::getFileName(path);
+		size_t pos = pattern.find('%');
+		size_t end = pattern.find('d', pos);
+
+		string prefix = pattern.substr(0, pos), suffix = pattern.substr(end + 1);
+
+		ofDirectory dir(ofFilePath::getEnclosingDirectory(path, false));
+		dir.listDir();
+
+		vector<pair<int, string>> numbered;
+
+		for (auto& f : dir.getFiles()) {
+			string name = f.getFileName();
+			if (name.size() > prefix.size() + suffix.size() &&
+				name.compare(0, prefix.size(), prefix) == 0 &&
+				name.compare(name.size() - suffix.size(), suffix.size(), suffix) == 0) {
+
+				string digits = name.substr(prefix.size(), name.size() - prefix.size() - suffix.size());
+				if (digits.find_first_not_of("0123456789") == string::npos) {
+					numbered.push_back(make_pair(ofToInt(digits), f.getAbsolutePath()));
+				}
+			}
+		}
+
+		sort(numbered.begin(), numbered.end());
+
+		files.clear();
+		for (auto& n : numbered) {
+			files.push_back(n.second);
+		}
+
+		return !files.empty();
+	}
+
+	bool probe() {
+
+		string command = string(FFPROBE_PATH) + " -v error -select_streams v:0" +
+			" -show_entries stream=width,height:format=duration -of default=nw=1 " + Shell::quote(path);
+
+		string output = ofSystem(command);
+
+		float seconds = 0;
+
+		for (auto& line : ofSplitString(output, "\n", true, true)) {
+			vector<string> kv = ofSplitString(line, "=");
+			if (kv.size() != 2) continue;
+			if (kv[0] == "width")		width = ofToInt(kv[1]);
+			if (kv[0] == "height")		height = ofToInt(kv[1]);
+			if (kv[0] == "duration")	seconds = ofToFloat(kv[1]);
+		}
+
+		duration = seconds;
+		length = max(1, (int)(seconds * frameRate));
+
+		return width > 0 && height > 0;
+	}
+
+	void threadedFunction() {
+
+		ofPixels scratch;
+
+		while (true) {
+
+			VideoFrame *slot = NULL;
+			int next = -1, fps;
+
+			{
+				unique_lock<mutex> lock(mtx);
+
+				while (running) {
+
+					fps = frameRate;
+
+					// first frame of the window that is not decoded yet
+					int windowEnd = min(requested + VIDEO_RING_FRAMES, length);
+					next = -1;
+					for (int f = requested; f < windowEnd && next < 0; f++) {
+						if (findSlot(f) == NULL) {
+							next = f;
+						}
+					}
+
+					// reuse a slot that has fallen out of the window
+					slot = NULL;
+					if (next >= 0) {
+						for (auto& s : ring) {
+							if (!s.pinned && (!s.ready || s.frame < requested || s.frame >= windowEnd)) {
+								slot = &s;
+								break;
+							}
+						}
+					}
+
+					if (slot != NULL) {
+						slot->ready = false;
+						slot->pinned = true;
+						break;
+					}
+
+					cv.wait(lock);
+				}
+
+				if (!running) {
+					break;
+				}
+			}
+
+			bool decoded;
+
+			if (isSequence(path)) {
+				// a broken file in a sequence shows as black rather than stalling export
+				if (!readSequenceFrame(next, slot->pixels)) {
+					slot->pixels.set(0);
+				}
+				decoded = true;
+			} else {
+				decoded = readVideoFrame(next, fps, slot->pixels, scratch);
+				if (!decoded && next == 0) {
+					// nothing decodable at all, show black instead of retrying
+					slot->pixels.set(0);
+					decoded = true;
+				}
+			}
+
+			{
+				lock_guard<mutex> lock(mtx);
+				slot->pinned = false;
+				slot->frame = next;
+				slot->ready = decoded;
+				if (!decoded) {
+					// past the real end of the movie, hold the last good frame
+					length = max(1, next);
+				}
+			}
+		}
+
+		closePipe();
+	}
+
+	bool readSequenceFrame(int frame, ofPixels &pixels) {
+
+		if (!ofLoadImage(loadPixels, files[frame]) ||
+			loadPixels.getWidth() != width || loadPixels.getHeight() != height) {
+			ofLogError("VideoSource") << "Failed to load " << files[frame];
+			return false;
+		}
+
+		// expand to RGBA in place of the slot, it stays allocated
+		int channels = loadPixels.getNumChannels();
+		const unsigned char *src = loadPixels.getData();
+		unsigned char *dst = pixels.getData();
+
+		for (size_t i = 0, n = (size_t)width * height; i < n; i++, src += channels, dst += 4) {
+			dst[0] = src[0];
+			dst[1] = src[channels >= 3 ? 1 : 0];
+			dst[2] = src[channels >= 3 ? 2 : 0];
+			dst[3] = channels == 4 ? src[3] : channels == 2 ? src[1] : 255;
+		}
+		return true;
+	}
+
+	bool readVideoFrame(int frame, int fps, ofPixels &pixels, ofPixels &scratch) {
+
+		// sequential reads are the common case, seek only for jumps
+		if (pipe == NULL || fps != pipeFps || frame < pipeFrame || frame - pipeFrame > VIDEO_SKIP_FRAMES) {
+			openPipe(frame, fps);
+		}
+
+		if (pipe == NULL) {
+			return false;
+		}
+
+		if (!scratch.isAllocated()) {
+			scratch.allocate(width, height, OF_PIXELS_RGBA);
+		}
+
+		while (pipeFrame < frame) {
+			if (fread(scratch.getData(), 1, scratch.size(), pipe) != scratch.size()) {
+				closePipe();
+				return false;
+			}
+			pipeFrame++;
+		}
+
+		if (fread(pixels.getData(), 1, pixels.size(), pipe) != pixels.size()) {
+			closePipe();
+			return false;
+		}
+		pipeFrame++;
+
+		return true;
+	}
+
+	void openPipe(int frame, int fps) {
+
+		closePipe();
+
+		// resampled to the renderer's frame rate, so frame n is at n / fps
+		string command = string(FFMPEG_PATH) + " -loglevel error" +
+			" -ss " + ofToString(frame / (float)fps, 4) +
+			" -i " + Shell::quote(path) +
+			" -f rawvideo -pix_fmt rgba -r " + ofToString(fps) + " -";
+
+		ofLogVerbose("VideoSource") << command;
+
+		pipe = popen(command.c_str(), "r");
+		pipeFrame = frame;
+		pipeFps = fps;
+
+		if (pipe == NULL) {
+			ofLogError("VideoSource") << "Failed to launch ffmpeg for " << path;
+		}
+	}
+
+	void closePipe() {
+		if (pipe != NULL) {
+			pclose(pipe);
+			pipe = NULL;
+		}
+	}
+
+	string				path;
+	vector<string>		files;		// sequence frames in order
+	ofPixels			loadPixels;
+
+	int					width = 0;
+	int					height = 0;
+	float				duration = 0;	// seconds, movies only
+	int					length = 1;		// frames at frameRate
+
+	// decoder thread
+	FILE				*pipe = NULL;
+	int					pipeFrame = 0;
+	int					pipeFps = 0;
+
+	VideoFrame			ring[VIDEO_RING_FRAMES];
+	int					requested = 0;
+	int					frameRate = 30;
+
+	std::thread			thread;
+	mutex				mtx;
+	condition_variable	cv;
+	bool				running = false;
+
+	// main thread
+	ofTexture			texture;
+	ofBufferObject		pbos[2];
+	int					pboIndex = 0;
+	int					uploadedFrame = -1;
+};
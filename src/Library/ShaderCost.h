@@ -0,0 +1,300 @@
+#pragma once
+
+#include <regex>
+#include "ofMain.h"
+
+#define SHADER_COST_LOOP_GUESS		64		// iterations assumed when a bound is not constant
+
+struct ShaderCost {
+	float			alu = 0;		// arithmetic per fragment, transcendental calls weigh more
+	float			textures = 0;	// texture fetches per fragment
+	vector<string>	warnings;
+};
+
+// Rough static cost of a fragment shader, read from the GLSL source: every
+// user function is costed once, loops multiply their body by a constant
+// bound when there is one, and calls are resolved from main(). It is meant
+// to compare shaders and to explain a slow sample render, not to predict
+// the GPU's own scheduling.
+
+class ShaderCostEstimator {
+public:
+
+	static ShaderCost estimate(const string &source) {
+
+		ShaderCostEstimator estimator;
+		estimator.tokenize(source);
+		estimator.readDefines(source);
+		estimator.readFunctions();
+
+		ShaderCost cost;
+
+		if (estimator.functions.find("main") == estimator.functions.end()) {
+			cost.warnings.push_back("no main()");
+			return cost;
+		}
+
+		Total total = estimator.resolve("main", 0);
+		cost.alu = total.alu;
+		cost.textures = total.textures;
+		cost.warnings = estimator.warnings;
+
+		return cost;
+	}
+
+private:
+
+	struct Call {
+		string	name;
+		float	count;
+	};
+
+	struct Function {
+		float			alu = 0;
+		float			textures = 0;
+		vector<Call>	calls;
+		size_t			begin, end;		// token range of the body
+	};
+
+	struct Total {
+		float	alu = 0;
+		float	textures = 0;
+	};
+
+	void tokenize(const string &source) {
+
+		static regex tokenRegex("[A-Za-z_][A-Za-z0-9_]*|[0-9]*\\.?[0-9]+(?:[eE][-+]?[0-9]+)?[fF]?|\\+\\+|--|[-+*/<>=!&|]=?|[{}()\\[\\];,.?:]");
+
+		// comments and preprocessor lines are not code
+		string code;
+		bool blockComment = false;
+
+		for (auto& line : ofSplitString(source, "\n")) {
+
+			size_t first = line.find_first_not_of(" \t");
+			if (!blockComment && first != string::npos && line[first] == '#') {
+				continue;
+			}
+
+			for (size_t i = 0; i < line.size(); i++) {
+				if (blockComment) {
+					if (line.compare(i, 2, "*/") == 0) {
+						blockComment = false;
+						i++;
+					}
+				} else if (line.compare(i, 2, "/*") == 0) {
+					blockComment = true;
+					i++;
+				} else if (line.compare(i, 2, "//") == 0) {
+					break;
+				} else {
+					code += line[i];
+				}
+			}
+			code += '\n';
+		}
+
+		for (sregex_iterator it(code.begin(), code.end(), tokenRegex), end; it != end; ++it) {
+			tokens.push_back(it->str());
+		}
+	}
+
+	void readDefines(const string &source) {
+
+		static regex defineRegex("[ \t]*#define[ \t]+([A-Za-z_][A-Za-z0-9_]*)[ \t]+([0-9.]+).*");
+		static regex constRegex(".*const[ \t]+(?:int|float)[ \t]+([A-Za-z_][A-Za-z0-9_]*)[ \t]*=[ \t]*([0-9.]+).*");
+
+		smatch m;
+
+		for (auto& line : ofSplitString(source, "\n")) {
+			if (regex_match(line, m, defineRegex) || regex_match(line, m, constRegex)) {
+				constants[m[1].str()] = ofToFloat(m[2].str());
+			}
+		}
+	}
+
+	// top level `type name(...) {` at brace depth 0
+	void readFunctions() {
+
+		int depth = 0;
+
+		for (size_t i = 0; i < tokens.size(); i++) {
+
+			if (tokens[i] == "{") {
+				depth++;
+			} else if (tokens[i] == "}") {
+				depth--;
+			} else if (depth == 0 && i + 1 < tokens.size() && tokens[i + 1] == "(" && i > 0 && isIdentifier(tokens[i - 1])) {
+
+				size_t close = matching(i + 1, "(", ")");
+				if (close + 1 < tokens.size() && tokens[close + 1] == "{") {
+
+					Function &f = functions[tokens[i]];
+					f.begin = close + 2;
+					f.end = matching(close + 1, "{", "}");
+					i = f.end;
+
+					costBody(f);
+				}
+			}
+		}
+	}
+
+	void costBody(Function &f) {
+
+		// multiplier stack of the enclosing loops, with the token where each ends
+		vector<pair<size_t, float>> loops;
+		float multiplier = 1;
+
+		for (size_t i = f.begin; i < f.end; i++) {
+
+			while (!loops.empty() && i > loops.back().first) {
+				multiplier /= loops.back().second;
+				loops.pop_back();
+			}
+
+			const string &t = tokens[i];
+
+			if ((t == "for" || t == "while") && i + 1 < f.end && tokens[i + 1] == "(") {
+
+				size_t close = matching(i + 1, "(", ")");
+				float iterations = t == "for" ? forIterations(i + 2, close) : -1;
+
+				if (iterations < 0) {
+					warnings.push_back("unbounded " + t + " loop, assuming " + ofToString(SHADER_COST_LOOP_GUESS) + " iterations");
+					iterations = SHADER_COST_LOOP_GUESS;
+				}
+
+				// the body is a block or a single statement
+				size_t bodyEnd = close + 1 < f.end && tokens[close + 1] == "{" ? matching(close + 1, "{", "}") : statementEnd(close + 1);
+
+				loops.push_back(make_pair(bodyEnd, iterations));
+				multiplier *= iterations;
+
+				i = close;
+				continue;
+			}
+
+			if (isIdentifier(t) && i + 1 < f.end && tokens[i + 1] == "(") {
+
+				if (t == "texture2D" || t == "texture" || t == "texture2DLod" || t == "textureLod" || t == "texelFetch") {
+					f.textures += multiplier;
+				} else if (builtinCost(t) > 0) {
+					f.alu += builtinCost(t) * multiplier;
+				} else {
+					f.calls.push_back((Call){t, multiplier});
+				}
+				continue;
+			}
+
+			if (t == "+" || t == "-" || t == "*" || t == "/" || t == "+=" || t == "-=" || t == "*=" || t == "/=") {
+				f.alu += multiplier;
+			}
+		}
+	}
+
+	// `for (int i = A; i < B; i++)` with constant A and B, -1 otherwise
+	float forIterations(size_t begin, size_t end) {
+
+		vector<string> header(tokens.begin() + begin, tokens.begin() + end);
+		string text = ofJoinString(header, " ");
+
+		static regex forRegex("^(?:int |float )?(\\w+) = ([\\w.]+) ; (\\w+) (<|<=|>|>=) ([\\w.]+) ;.*");
+		smatch m;
+
+		if (!regex_match(text, m, forRegex) || m[1].str() != m[3].str()) {
+			return -1;
+		}
+
+		float from, to;
+		if (!constant(m[2].str(), &from) || !constant(m[5].str(), &to)) {
+			return -1;
+		}
+
+		float count = fabs(to - from) + (m[4].str().size() == 2 ? 1 : 0);
+		return max(count, 0.0f);
+	}
+
+	bool constant(const string &token, float *value) {
+		if (!token.empty() && (isdigit(token[0]) || token[0] == '.')) {
+			*value = ofToFloat(token);
+			return true;
+		}
+		auto it = constants.find(token);
+		if (it != constants.end()) {
+			*value = it->second;
+			return true;
+		}
+		return false;
+	}
+
+	Total resolve(const string &name, int depth) {
+
+		Total total;
+		auto it = functions.find(name);
+
+		// constructors like vec3() and recursion, which GLSL does not allow anyway
+		if (it == functions.end() || depth > 32) {
+			return total;
+		}
+
+		auto cached = resolved.find(name);
+		if (cached != resolved.end()) {
+			return cached->second;
+		}
+
+		const Function &f = it->second;
+		total.alu = f.alu;
+		total.textures = f.textures;
+
+		for (auto& call : f.calls) {
+			Total callee = resolve(call.name, depth + 1);
+			total.alu += callee.alu * call.count;
+			total.textures += callee.textures * call.count;
+		}
+
+		resolved[name] = total;
+		return total;
+	}
+
+	static float builtinCost(const string &name) {
+		static const map<string, float> costs = {
+			{"sin", 4}, {"cos", 4}, {"tan", 6}, {"asin", 8}, {"acos", 8}, {"atan", 8},
+			{"pow", 6}, {"exp", 4}, {"exp2", 2}, {"log", 4}, {"log2", 2},
+			{"sqrt", 2}, {"inversesqrt", 2}, {"length", 3}, {"distance", 4}, {"normalize", 4},
+			{"dot", 2}, {"cross", 3}, {"reflect", 4}, {"refract", 8},
+			{"mix", 2}, {"smoothstep", 4}, {"step", 1}, {"clamp", 1}, {"min", 1}, {"max", 1},
+			{"abs", 1}, {"floor", 1}, {"ceil", 1}, {"fract", 1}, {"mod", 2}, {"sign", 1},
+			{"dFdx", 1}, {"dFdy", 1}, {"fwidth", 2}
+		};
+		auto it = costs.find(name);
+		return it != costs.end() ? it->second : 0;
+	}
+
+	static bool isIdentifier(const string &t) {
+		static const set<string> keywords = {"if", "for", "while", "return", "else"};
+		return !t.empty() && (isalpha(t[0]) || t[0] == '_') && keywords.find(t) == keywords.end();
+	}
+
+	size_t matching(size_t open, const string &a, const string &b) {
+		int depth = 0;
+		for (size_t i = open; i < tokens.size(); i++) {
+			if (tokens[i] == a) depth++;
+			else if (tokens[i] == b && --depth == 0) return i;
+		}
+		return tokens.size() - 1;
+	}
+
+	size_t statementEnd(size_t begin) {
+		for (size_t i = begin; i < tokens.size(); i++) {
+			if (tokens[i] == ";") return i;
+		}
+		return tokens.size() - 1;
+	}
+
+	vector<string>			tokens;
+	map<string, float>		constants;
+	map<string, Function>	functions;
+	map<string, Total>		resolved;
+	vector<string>			warnings;
+};
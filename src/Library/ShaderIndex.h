@@ -0,0 +1,393 @@
+#pragma once
+
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <unordered_map>
+#include "ofMain.h"
+
+#include "Hash.h"
+#include "ShaderScanner.h"
+
+#define SHADER_INDEX_PATH		ofToDataPath("shader-index.tsv")
+#define SHADER_INDEX_INTERVAL	2.0		// seconds between background rescans
+
+struct ShaderIndexEntry {
+	string			path;		// absolute
+	string			name;		// relative to the root, used for display and search
+	uint64_t		size = 0;
+	time_t			modified = 0;
+	uint64_t		hash = 0;	// content hash, with the files it includes
+	vector<string>	uniforms;	// "type name"
+	vector<string>	textures;	// "name location"
+	vector<string>	includes;	// absolute
+	uint64_t		includesStamp = 0;	// sizes and mtimes of the includes
+};
+
+typedef vector<ShaderIndexEntry> ShaderIndexEntries;
+
+// Incremental, recursive index of the shader files under a folder. A
+// background thread stats the tree and only re-reads files whose size or
+// mtime changed, or whose includes did, then publishes an immutable snapshot.
+// The index is persisted so a restart only needs to stat, not to read every
+// file again.
+
+class ShaderIndex {
+public:
+
+	ShaderIndex() : entries(make_shared<ShaderIndexEntries>()) {}
+
+	~ShaderIndex() {
+		close();
+	}
+
+	void open(string path) {
+
+		close();
+
+		root = path;
+
+		{
+			lock_guard<mutex> lock(mtx);
+			entries = make_shared<ShaderIndexEntries>();
+			revision++;
+		}
+
+		running = true;
+		thread = std::thread(&ShaderIndex::threadedFunction, this);
+	}
+
+	void close() {
+
+		if (!thread.joinable()) {
+			return;
+		}
+
+		{
+			lock_guard<mutex> lock(mtx);
+			running = false;
+		}
+		cond.notify_all();
+		thread.join();
+	}
+
+	void rescan() {
+		{
+			lock_guard<mutex> lock(mtx);
+			rescanRequested = true;
+		}
+		cond.notify_all();
+	}
+
+	// the latest snapshot, and with `revision` the revision it was published
+	// as, read together so a snapshot is never paired with a later revision
+	shared_ptr<const ShaderIndexEntries> getEntries(int *revision = NULL) {
+		lock_guard<mutex> lock(mtx);
+		if (revision) {
+			*revision = this->revision;
+		}
+		return entries;
+	}
+
+	// incremented every time a new snapshot is published, to poll for changes
+	int getRevision() {
+		return revision;
+	}
+
+	bool isScanning() {
+		return scanning;
+	}
+
+	const string& getRoot() {
+		return root;
+	}
+
+	// Subsequence match. Returns -1 when `query` is not contained in `text`,
+	// otherwise a score where consecutive matches and matches at the start of
+	// a path component or word rank higher.
+	static int fuzzyScore(const char *query, const string &text) {
+
+		if (*query == '\0') {
+			return 0;
+		}
+
+		int score = 0, streak = 0;
+		const char *q = query;
+
+		for (size_t i = 0; i < text.size() && *q != '\0'; i++) {
+
+			char c = tolower(text[i]);
+
+			if (c == tolower(*q)) {
+
+				streak++;
+				score += 1 + streak * 2;
+
+				if (i == 0 || text[i - 1] == '/' || text[i - 1] == '_' || text[i - 1] == '-' || text[i - 1] == ' ') {
+					score += 8;
+				}
+				q++;
+
+			} else {
+				streak = 0;
+			}
+		}
+
+		return *q == '\0' ? score : -1;
+	}
+
+private:
+
+	void threadedFunction() {
+
+		// the persisted index is read here too, so opening never blocks
+		loadCache();
+
+		while (true) {
+
+			scanning = true;
+			scan();
+			scanning = false;
+
+			unique_lock<mutex> lock(mtx);
+			cond.wait_for(lock, chrono::milliseconds((int)(SHADER_INDEX_INTERVAL * 1000)), [this] {
+				return !running || rescanRequested;
+			});
+
+			if (!running) {
+				break;
+			}
+			rescanRequested = false;
+		}
+	}
+
+	void scan() {
+
+		shared_ptr<const ShaderIndexEntries> prev = getEntries();
+
+		unordered_map<string, const ShaderIndexEntry*> known;
+		known.reserve(prev->size());
+		for (auto& entry : *prev) {
+			known[entry.path] = &entry;
+		}
+
+		auto next = make_shared<ShaderIndexEntries>();
+		next->reserve(prev->size());
+
+		bool changed = false;
+
+		try {
+
+			filesystem::path rootPath(root);
+
+			if (!filesystem::is_directory(rootPath)) {
+				return;
+			}
+
+			filesystem::recursive_directory_iterator it(rootPath), end;
+
+			for (; it != end; ++it) {
+
+				if (!running) {
+					return;
+				}
+
+				const filesystem::path &p = it->path();
+				string fileName = p.filename().string();
+
+				if (!fileName.empty() && fileName[0] == '.') {
+					if (filesystem::is_directory(p)) {
+						skipDirectory(it);
+					}
+					continue;
+				}
+
+				if (!filesystem::is_regular_file(p)) {
+					continue;
+				}
+
+				string ext = p.extension().string();
+				if (ext != ".frag" && ext != ".fs") {
+					continue;
+				}
+
+				string path = p.string();
+				uint64_t size = filesystem::file_size(p);
+				time_t modified = filesystem::last_write_time(p);
+
+				auto found = known.find(path);
+
+				if (found != known.end() && found->second->size == size && found->second->modified == modified &&
+					found->second->includesStamp == getIncludesStamp(found->second->includes)) {
+					next->push_back(*found->second);
+					continue;
+				}
+
+				ShaderIndexEntry entry;
+				entry.path = path;
+				entry.name = path.substr(root.size() + (root.back() == '/' ? 0 : 1));
+				entry.size = size;
+				entry.modified = modified;
+				readEntry(entry);
+
+				next->push_back(entry);
+				changed = true;
+			}
+
+		} catch (exception &e) {
+			ofLogWarning("ShaderIndex") << "Failed to scan " << root << ": " << e.what();
+			return;
+		}
+
+		if (!changed && next->size() == prev->size()) {
+			return;
+		}
+
+		sort(next->begin(), next->end(), [](const ShaderIndexEntry &a, const ShaderIndexEntry &b) {
+			return a.name < b.name;
+		});
+
+		{
+			lock_guard<mutex> lock(mtx);
+			entries = next;
+			revision++;
+		}
+
+		saveCache(*next);
+	}
+
+	template<typename Iterator>
+	static void skipDirectory(Iterator &it) {
+		// boost::filesystem and std::filesystem name this differently
+		#ifdef BOOST_FILESYSTEM_VERSION
+		it.no_push();
+		#else
+		it.disable_recursion_pending();
+		#endif
+	}
+
+	static void readEntry(ShaderIndexEntry &entry) {
+
+		ofBuffer buffer = ofBufferFromFile(entry.path);
+
+		entry.hash = Hash::fnv1a(buffer.getData(), buffer.size());
+		entry.uniforms.clear();
+		entry.textures.clear();
+		entry.includes.clear();
+
+		ShaderDeclarations declarations = ShaderScanner::scan(buffer.getData(), buffer.size());
+
+		// hashed the same way as RenderEngine, so thumbnails follow edits to them
+		for (auto& include : declarations.includes) {
+			string path = ofFilePath::join(ofFilePath::getEnclosingDirectory(entry.path, false), include.path);
+			ofBuffer included = ofBufferFromFile(path, true);
+			entry.hash = Hash::fnv1a(include.path, entry.hash);
+			entry.hash = Hash::fnv1a(included.getData(), included.size(), entry.hash);
+			entry.includes.push_back(path);
+		}
+
+		entry.includesStamp = getIncludesStamp(entry.includes);
+
+		for (auto& uniform : declarations.uniforms) {
+
+			entry.uniforms.push_back(uniform.type + " " + uniform.name);
+
+			if (uniform.type == "sampler2D" && uniform.arraySize == 0 && !uniform.annotation.empty()) {
+				entry.textures.push_back(uniform.name + " " + uniform.getLocation());
+			}
+		}
+	}
+
+	static uint64_t getIncludesStamp(const vector<string> &includes) {
+
+		uint64_t stamp = Hash::FNV_OFFSET;
+
+		for (auto& path : includes) {
+			filesystem::path p(path);
+			if (filesystem::is_regular_file(p)) {
+				stamp = Hash::combine(stamp, (uint64_t)filesystem::file_size(p));
+				stamp = Hash::combine(stamp, (int64_t)filesystem::last_write_time(p));
+			} else {
+				stamp = Hash::combine(stamp, (int64_t)-1);
+			}
+		}
+
+		return stamp;
+	}
+
+	// cache file: first line is the root, then one tab separated entry per line
+
+	void loadCache() {
+
+		auto loaded = make_shared<ShaderIndexEntries>();
+
+		ofBuffer buffer = ofBufferFromFile(SHADER_INDEX_PATH);
+
+		bool first = true;
+
+		for (auto& line : buffer.getLines()) {
+
+			if (first) {
+				first = false;
+				if (line != root) {
+					break;
+				}
+				continue;
+			}
+
+			vector<string> cols = ofSplitString(line, "\t", false, false);
+
+			if (cols.size() != 9) {
+				continue;
+			}
+
+			ShaderIndexEntry entry;
+			entry.path		= cols[0];
+			entry.name		= cols[1];
+			entry.size		= strtoull(cols[2].c_str(), NULL, 10);
+			entry.modified	= (time_t)strtoll(cols[3].c_str(), NULL, 10);
+			entry.hash		= Hash::fromHex(cols[4]);
+			entry.uniforms	= ofSplitString(cols[5], ";", true);
+			entry.textures	= ofSplitString(cols[6], ";", true);
+			entry.includes	= ofSplitString(cols[7], ";", true);
+			entry.includesStamp = Hash::fromHex(cols[8]);
+
+			loaded->push_back(entry);
+		}
+
+		lock_guard<mutex> lock(mtx);
+		entries = loaded;
+		revision++;
+	}
+
+	void saveCache(const ShaderIndexEntries &list) {
+
+		ofBuffer buffer;
+
+		buffer.append(root + "\n");
+
+		for (auto& entry : list) {
+			buffer.append(entry.path + "\t" + entry.name + "\t" +
+						  ofToString(entry.size) + "\t" + ofToString((long long)entry.modified) + "\t" +
+						  Hash::toHex(entry.hash) + "\t" +
+						  ofJoinString(entry.uniforms, ";") + "\t" +
+						  ofJoinString(entry.textures, ";") + "\t" +
+						  ofJoinString(entry.includes, ";") + "\t" +
+						  Hash::toHex(entry.includesStamp) + "\n");
+		}
+
+		ofBufferToFile(SHADER_INDEX_PATH, buffer);
+	}
+
+	string								root;
+
+	shared_ptr<const ShaderIndexEntries>	entries;
+	atomic<int>							revision {0};
+	atomic<bool>						scanning {false};
+
+	std::thread							thread;
+	mutex								mtx;
+	condition_variable					cond;
+	atomic<bool>						running {false};
+	bool								rescanRequested = false;
+};
@@ -0,0 +1,203 @@
+#pragma once
+
+#include <regex>
+#include "ofMain.h"
+
+#include "Config.h"
+#include "Shell.h"
+#include "Hash.h"
+
+#define SHADER_CACHE_DIR			ofToDataPath("shader-cache")
+#define SHADER_OPTIMIZER_VERSION	1
+
+#ifdef TARGET_WIN32
+#define SHADER_OPTIMIZER_QUIET		" > NUL 2>&1"
+#else
+#define SHADER_OPTIMIZER_QUIET		" > /dev/null 2>&1"
+#endif
+
+// Optimizes fragment shader source before it goes to the driver, for
+// drivers that do little of it themselves. Functions that main() never
+// reaches are always removed; when glslangValidator, spirv-opt and
+// spirv-cross are installed the result also goes through SPIR-V and back to
+// GLSL 1.20. The output is cached in data/shader-cache by source hash.
+
+class ShaderOptimizer {
+public:
+
+	// the optimized source, with what was done to it in `log`
+	static string optimize(const string &source, string *log) {
+
+		uint64_t key = Hash::combine(Hash::fnv1a(source), SHADER_OPTIMIZER_VERSION);
+		string cachePath = ofFilePath::join(SHADER_CACHE_DIR, Hash::toHex(key) + ".frag");
+
+		if (ofFile::doesFileExist(cachePath, false)) {
+			*log = "cached";
+			return ofBufferFromFile(cachePath).getText();
+		}
+
+		ofDirectory::createDirectory(SHADER_CACHE_DIR, false, true);
+
+		string result = removeDeadFunctions(source);
+		string spirv = throughSpirv(result, cachePath, log);
+
+		if (!spirv.empty()) {
+			result = spirv;
+		}
+
+		ofBuffer buffer(result.data(), result.size());
+		ofBufferToFile(cachePath, buffer);
+
+		return result;
+	}
+
+	// drops top level function definitions that are not reachable from main()
+	static string removeDeadFunctions(const string &source) {
+
+		struct Definition {
+			size_t			begin, end;
+			set<string>		calls;
+		};
+
+		static regex callRegex("([A-Za-z_][A-Za-z0-9_]*)[ \t\n]*\\(");
+		static regex headRegex("[\\s\\S]*?([A-Za-z_][A-Za-z0-9_]*)[ \t\n]*\\([^()]*\\)[ \t\n]*$");
+
+		map<string, vector<Definition>> definitions;	// overloads share a name
+
+		int depth = 0;
+		size_t statementStart = 0, bodyStart = 0;
+
+		for (size_t i = 0; i < source.size(); i++) {
+
+			// skip comments and preprocessor lines
+			if (source.compare(i, 2, "//") == 0 || (source[i] == '#' && (i == 0 || source[i - 1] == '\n'))) {
+				i = source.find('\n', i);
+				if (i == string::npos) break;
+				if (depth == 0) statementStart = i + 1;
+				continue;
+			}
+			if (source.compare(i, 2, "/*") == 0) {
+				i = source.find("*/", i);
+				if (i == string::npos) break;
+				i++;
+				continue;
+			}
+
+			char c = source[i];
+
+			if (c == '{') {
+				if (depth++ == 0) {
+					bodyStart = i;
+				}
+			} else if (c == '}') {
+				if (--depth == 0) {
+
+					string head = source.substr(statementStart, bodyStart - statementStart);
+					smatch m;
+
+					if (regex_match(head, m, headRegex)) {
+
+						Definition def;
+						def.begin = statementStart;
+						def.end = i + 1;
+
+						string body = source.substr(bodyStart, i - bodyStart);
+						for (sregex_iterator it(body.begin(), body.end(), callRegex), end; it != end; ++it) {
+							def.calls.insert((*it)[1].str());
+						}
+
+						definitions[m[1].str()].push_back(def);
+					}
+
+					statementStart = i + 1;
+				}
+			} else if (c == ';' && depth == 0) {
+				statementStart = i + 1;
+			}
+		}
+
+		if (definitions.find("main") == definitions.end()) {
+			return source;
+		}
+
+		// reachability from main
+		set<string> reached;
+		vector<string> stack = {"main"};
+
+		while (!stack.empty()) {
+			string name = stack.back();
+			stack.pop_back();
+			if (!reached.insert(name).second) {
+				continue;
+			}
+			for (auto& def : definitions[name]) {
+				for (auto& call : def.calls) {
+					if (definitions.find(call) != definitions.end()) {
+						stack.push_back(call);
+					}
+				}
+			}
+		}
+
+		vector<pair<size_t, size_t>> dead;
+		for (auto& iter : definitions) {
+			if (reached.find(iter.first) == reached.end()) {
+				for (auto& def : iter.second) {
+					dead.push_back(make_pair(def.begin, def.end));
+				}
+			}
+		}
+
+		sort(dead.begin(), dead.end());
+
+		string result;
+		size_t pos = 0;
+		for (auto& range : dead) {
+			result += source.substr(pos, range.first - pos);
+			// keep the line count close, so driver errors still point near the original
+			result += string(count(source.begin() + range.first, source.begin() + range.second, '\n'), '\n');
+			pos = range.second;
+		}
+		result += source.substr(pos);
+
+		return result;
+	}
+
+private:
+
+	// GLSL -> SPIR-V -> spirv-opt -> GLSL 1.20, empty if any tool is missing or fails
+	static string throughSpirv(const string &source, const string &cachePath, string *log) {
+
+		string base = cachePath.substr(0, cachePath.size() - 5);
+		string input = base + ".in.frag", spv = base + ".spv", opt = base + ".opt.spv", output = base + ".out.frag";
+
+		ofBuffer buffer(source.data(), source.size());
+		ofBufferToFile(input, buffer);
+
+		vector<string> commands = {
+			string(GLSLANG_PATH) + " --target-env opengl --auto-map-locations -S frag -o " + Shell::quote(spv) + " " + Shell::quote(input),
+			string(SPIRV_OPT_PATH) + " -O " + Shell::quote(spv) + " -o " + Shell::quote(opt),
+			string(SPIRV_CROSS_PATH) + " --version 120 --no-es --output " + Shell::quote(output) + " " + Shell::quote(opt)
+		};
+
+		string result;
+		*log = "dead functions removed";
+
+		for (auto& command : commands) {
+			if (system((command + SHADER_OPTIMIZER_QUIET).c_str()) != 0) {
+				*log += ", SPIR-V pass skipped (" + command.substr(0, command.find(' ')) + " failed)";
+				break;
+			}
+			if (&command == &commands.back()) {
+				result = ofBufferFromFile(output).getText();
+				*log += ", optimized through SPIR-V";
+			}
+		}
+
+		for (auto& path : {input, spv, opt, output}) {
+			ofFile::removeFile(path, false);
+		}
+
+		return result;
+	}
+};
@@ -0,0 +1,395 @@
+#pragma once
+
+#include <regex>
+#include <array>
+#include "ofMain.h"
+
+struct ShaderUniform {
+	string	type;
+	string	name;
+	int		arraySize = 0;	// 0 unless declared as an array, -1 when its size is not a literal
+	string	annotation;		// the line comment after the declaration, trimmed
+	int		line = 0;		// of the name, 1 based
+
+	// `uniform sampler2D name; // location options`
+	string getLocation() const {
+		return annotation.substr(0, annotation.find_first_of(" \t"));
+	}
+
+	string getOptions() const {
+		size_t end = annotation.find_first_of(" \t");
+		return end == string::npos ? "" : ofTrim(annotation.substr(end));
+	}
+};
+
+struct ShaderInclude {
+	string	path;			// as written, relative to the shader
+	int		line = 0;
+};
+
+struct ShaderComment {
+	string	text;			// without the comment markers
+	int		line = 0;		// where it starts
+	bool	block = false;
+};
+
+struct ShaderDeclarations {
+	vector<ShaderUniform>	uniforms;
+	vector<ShaderInclude>	includes;	// `#include` and oF's `#pragma include`
+	vector<ShaderComment>	comments;
+};
+
+// Reads the declarations of a GLSL source in one pass over its characters:
+// uniforms with any precision qualifier, several names or array sizes, and
+// the comment after them; includes; and every comment. Nothing inside a
+// comment is taken for code, but the preprocessor is not evaluated, so
+// uniforms in an `#if 0` block are still listed. Uniform blocks are skipped.
+
+class ShaderScanner {
+public:
+
+	static ShaderDeclarations scan(const string &source) {
+		return scan(source.data(), source.size());
+	}
+
+	static ShaderDeclarations scan(const char *data, size_t size) {
+		ShaderScanner scanner(data, size);
+		scanner.run();
+		return std::move(scanner.result);
+	}
+
+	// Times scan() against the per line regex it replaced, `iterations`
+	// times each over `source`. Both counts of sampler annotations are
+	// returned so a caller can see they agree.
+	struct Benchmark {
+		float	scanner;		// ms per pass
+		float	regex;
+		int		scannerTextures;
+		int		regexTextures;
+	};
+
+	static Benchmark benchmark(const string &source, int iterations) {
+
+		static const regex textureLineRegex("^[ \t]*uniform[ \t]+sampler2D[ \t]+([^ \t;]+)[ \t]*;[ \t]*//[ \t]*([^ \t]+)[ \t]*(.*)$");
+
+		Benchmark result;
+		result.scannerTextures = result.regexTextures = 0;
+
+		uint64_t start = ofGetElapsedTimeMicros();
+
+		for (int i = 0; i < iterations; i++) {
+			int count = 0;
+			ShaderDeclarations declarations = scan(source);
+			for (auto& uniform : declarations.uniforms) {
+				count += uniform.type == "sampler2D" && uniform.arraySize == 0 && !uniform.annotation.empty();
+			}
+			result.scannerTextures = count;
+		}
+
+		result.scanner = (ofGetElapsedTimeMicros() - start) / 1000.0f / iterations;
+		start = ofGetElapsedTimeMicros();
+
+		for (int i = 0; i < iterations; i++) {
+			int count = 0;
+			ofBuffer buffer(source.data(), source.size());
+			smatch m;
+			for (auto& line : buffer.getLines()) {
+				count += regex_match(line, m, textureLineRegex);
+			}
+			result.regexTextures = count;
+		}
+
+		result.regex = (ofGetElapsedTimeMicros() - start) / 1000.0f / iterations;
+		return result;
+	}
+
+private:
+
+	ShaderScanner(const char *data, size_t size) : p(data), end(data + size), classes(getCharClasses()) {}
+
+	enum CharClass {
+		IDENTIFIER_START	= 1,
+		IDENTIFIER			= 2,
+		SPACE				= 4		// but newlines, they are counted
+	};
+
+	// one lookup per character instead of a chain of comparisons
+	static const uint8_t* getCharClasses() {
+		static const array<uint8_t, 256> classes = [] {
+			array<uint8_t, 256> table;
+			for (int c = 0; c < 256; c++) {
+				bool letter = (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '_';
+				bool digit = c >= '0' && c <= '9';
+				table[c] = (letter ? IDENTIFIER_START : 0) | (letter || digit ? IDENTIFIER : 0) |
+					(c == ' ' || c == '\t' || c == '\r' ? SPACE : 0);
+			}
+			return table;
+		}();
+		return classes.data();
+	}
+
+	bool is(char c, CharClass charClass) {
+		return (classes[(unsigned char)c] & charClass) != 0;
+	}
+
+	static bool isPrecision(const string &word) {
+		return word == "lowp" || word == "mediump" || word == "highp";
+	}
+
+	void run() {
+
+		bool lineStart = true;
+
+		while (p < end) {
+
+			char c = *p;
+
+			if (is(c, IDENTIFIER_START)) {
+				// words are compared in place, most are never copied
+				lineStart = false;
+				const char *start = p;
+				skipIdentifier();
+				if (p - start == 7 && memcmp(start, "uniform", 7) == 0) {
+					readUniform();
+				}
+
+			} else if (c == '\n') {
+				line++;
+				p++;
+				lineStart = true;
+
+			} else if (is(c, SPACE)) {
+				p++;
+
+			} else if (c == '/' && skipComment()) {
+				// a block comment leaves the line start as it was
+
+			} else if (c == '#' && lineStart) {
+				readDirective();
+
+			} else {
+				lineStart = false;
+				p++;
+			}
+		}
+	}
+
+	// records the comment at `p` and moves past it, false if there is none
+	bool skipComment() {
+
+		if (p + 1 >= end || p[0] != '/' || (p[1] != '/' && p[1] != '*')) {
+			return false;
+		}
+
+		ShaderComment comment;
+		comment.line = line;
+		comment.block = p[1] == '*';
+		p += 2;
+
+		const char *start = p, *stop;
+
+		if (comment.block) {
+			while (p < end && !(p[0] == '*' && p + 1 < end && p[1] == '/')) {
+				line += *p++ == '\n';
+			}
+			stop = p;
+			p = min(p + 2, end);
+		} else {
+			p = (const char*)memchr(p, '\n', end - p);
+			p = p != NULL ? p : end;
+			stop = p;
+		}
+
+		// trimmed before the copy
+		while (start < stop && isspace((unsigned char)*start)) {
+			start++;
+		}
+		while (stop > start && isspace((unsigned char)stop[-1])) {
+			stop--;
+		}
+
+		comment.text.assign(start, stop);
+		result.comments.push_back(std::move(comment));
+		return true;
+	}
+
+	// whitespace and comments, and newlines unless `sameLine`
+	void skipSpace(bool sameLine = false) {
+		while (p < end) {
+			if (is(*p, SPACE)) {
+				p++;
+			} else if (*p == '\n' && !sameLine) {
+				line++;
+				p++;
+			} else if (!skipComment()) {
+				return;
+			}
+		}
+	}
+
+	void skipIdentifier() {
+		while (p < end && is(*p, IDENTIFIER)) {
+			p++;
+		}
+	}
+
+	string readIdentifier() {
+		const char *start = p;
+		skipIdentifier();
+		return string(start, p);
+	}
+
+	// one preprocessor line, continued by backslashes
+	void readDirective() {
+
+		int directiveLine = line;
+		string text;
+
+		p++;
+
+		while (p < end && *p != '\n') {
+			if (*p == '\\' && p + 1 < end && (p[1] == '\n' || p[1] == '\r')) {
+				p += p[1] == '\r' && p + 2 < end && p[2] == '\n' ? 3 : 2;
+				line++;
+			} else if (skipComment()) {
+				text += ' ';
+			} else {
+				text += *p++;
+			}
+		}
+
+		vector<string> words = ofSplitString(text, " ", true, true);
+
+		if (words.size() >= 2 && words[0] == "pragma" && words[1] == "include") {
+			words.erase(words.begin());
+		}
+
+		if (words.size() >= 2 && words[0] == "include") {
+			string path = ofTrim(text.substr(text.find("include") + 7));
+			if (path.size() >= 2 && (path[0] == '"' || path[0] == '<')) {
+				path = path.substr(1, path.find_first_of("\">", 1) - 1);
+			}
+			ShaderInclude include;
+			include.path = path;
+			include.line = directiveLine;
+			result.includes.push_back(include);
+		}
+	}
+
+	// the rest of a declaration after `uniform`
+	void readUniform() {
+
+		string type;
+		size_t first = result.uniforms.size();	// the uniforms of this declaration
+
+		while (true) {
+
+			skipSpace();
+
+			if (p >= end) {
+				result.uniforms.resize(first);
+				return;
+			}
+
+			if (is(*p, IDENTIFIER_START)) {
+				int wordLine = line;
+				string word = readIdentifier();
+				if (type.empty()) {
+					if (!isPrecision(word)) {
+						type = word;
+					}
+				} else {
+					result.uniforms.push_back(ShaderUniform());
+					ShaderUniform &uniform = result.uniforms.back();
+					uniform.type = type;
+					uniform.name = std::move(word);
+					uniform.line = wordLine;
+				}
+
+			} else if (*p == '[') {
+				p++;
+				skipSpace();
+				int size = 0;
+				const char *digits = p;
+				while (p < end && *p >= '0' && *p <= '9') {
+					size = size * 10 + *p++ - '0';
+				}
+				// `t[N]` or `t[2 * N]` is still an array, of a size we do not know
+				skipSpace();
+				if (p == digits || p >= end || *p != ']') {
+					size = -1;
+				}
+				skipUntil("]");
+				if (result.uniforms.size() > first) {
+					result.uniforms.back().arraySize = size;
+				}
+
+			} else if (*p == '=') {
+				// an initializer, up to the next name or the end
+				p++;
+				skipUntil(",;");
+
+			} else if (*p == '{') {
+				// a uniform block, its members are not uniforms of their own
+				result.uniforms.resize(first);
+				p++;
+				skipUntil("}");
+				p = min(p + 1, end);
+				skipUntil(";");
+				p = min(p + 1, end);
+				return;
+
+			} else if (*p == ';') {
+				p++;
+				break;
+
+			} else {
+				p++;
+			}
+		}
+
+		// the comment after the semicolon is the annotation
+		size_t comments = result.comments.size();
+		skipSpace(true);
+
+		string annotation;
+		for (size_t i = comments; i < result.comments.size() && annotation.empty(); i++) {
+			if (!result.comments[i].block) {
+				annotation = result.comments[i].text;
+			}
+		}
+
+		for (size_t i = first; i < result.uniforms.size(); i++) {
+			result.uniforms[i].annotation = annotation;
+		}
+	}
+
+	// moves to the first of `stops` outside brackets and comments
+	void skipUntil(const char *stops) {
+
+		int depth = 0;
+
+		while (p < end) {
+			skipSpace();
+			if (p >= end) {
+				return;
+			}
+			if (depth == 0 && strchr(stops, *p) != NULL) {
+				return;
+			}
+			if (*p == '(' || *p == '[' || *p == '{') {
+				depth++;
+			} else if (*p == ')' || *p == ']' || *p == '}') {
+				depth--;
+			}
+			p++;
+		}
+	}
+
+	const char			*p;
+	const char			*end;
+	const uint8_t		*classes;
+	int					line = 1;
+
+	ShaderDeclarations	result;
+};
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <regex>
+#include "ofMain.h"
+
+// Turns uniforms that stay the same for a whole export into constants, so
+// the driver can fold them and drop the branches they decide. Uniforms with
+// a value in `values` get it, every other uniform outside `dynamic` gets the
+// zero it would have read at runtime since nothing ever sets it.
+
+class ShaderSpecializer {
+public:
+
+	static string specialize(const string &source, const map<string, string> &values, const set<string> &dynamic, int *count) {
+
+		static regex uniformRegex("^([ \t]*)uniform[ \t]+(?:(?:lowp|mediump|highp)[ \t]+)?([A-Za-z0-9_]+)[ \t]+([A-Za-z0-9_]+)[ \t]*;(.*)$");
+
+		string result;
+		smatch m;
+		*count = 0;
+
+		for (auto& line : ofSplitString(source, "\n")) {
+
+			if (regex_match(line, m, uniformRegex) && dynamic.find(m[3].str()) == dynamic.end()) {
+
+				string type = m[2].str(), name = m[3].str();
+				auto it = values.find(name);
+				string value = it != values.end() ? it->second : zero(type);
+
+				if (!value.empty()) {
+					result += m[1].str() + "const " + type + " " + name + " = " + value + ";" + m[4].str() + "\n";
+					(*count)++;
+					continue;
+				}
+			}
+
+			result += line + "\n";
+		}
+
+		return result;
+	}
+
+private:
+
+	// empty for types that cannot be constants, like samplers
+	static string zero(const string &type) {
+		if (type == "float")								return "0.0";
+		if (type == "int")									return "0";
+		if (type == "bool")									return "false";
+		if (type.compare(0, 3, "vec") == 0 || type.compare(0, 3, "mat") == 0)		return type + "(0.0)";
+		if (type.compare(0, 4, "ivec") == 0)				return type + "(0)";
+		if (type.compare(0, 4, "bvec") == 0)				return type + "(false)";
+		return "";
+	}
+};
@@ -0,0 +1,209 @@
+#pragma once
+
+#include <deque>
+#include <unordered_map>
+#include "ofMain.h"
+
+#include "Hash.h"
+#include "ShaderIndex.h"
+#include "RenderEngine.h"
+#include "VideoSource.h"
+#include "AudioSource.h"
+
+#define THUMBNAIL_DIR			ofToDataPath("thumbnails")
+#define THUMBNAIL_SIZE			128
+#define THUMBNAIL_TIME			1.0f	// seconds, the representative frame
+#define THUMBNAIL_RECHECK		2.0f	// seconds between dependency checks
+#define THUMBNAIL_QUEUE_MAX		64
+
+struct Thumbnail {
+	uint64_t	key = 0;
+	float		checkedAt = -THUMBNAIL_RECHECK;
+	bool		ready = false;
+	bool		failed = false;
+	ofTexture	texture;
+};
+
+// Renders small previews of shaders on the main thread, but only within a
+// per-frame slice of time so the main preview never hitches. Results are kept
+// in a disk cache keyed by the shader contents, the files it includes and the
+// textures it uses, so a thumbnail is only rendered again when one of them
+// actually changes.
+
+class ThumbnailRenderer {
+public:
+
+	void setup() {
+		ofDirectory::createDirectory(THUMBNAIL_DIR, false, true);
+		fbo.allocate(THUMBNAIL_SIZE, THUMBNAIL_SIZE, GL_RGB);
+	}
+
+	// Returns the texture if it is ready, otherwise queues the job
+	ofTexture* get(const ShaderIndexEntry &entry) {
+
+		Thumbnail &thumb = thumbnails[entry.path];
+
+		float now = ofGetElapsedTimef();
+
+		if (now - thumb.checkedAt > THUMBNAIL_RECHECK) {
+
+			thumb.checkedAt = now;
+			uint64_t key = getKey(entry);
+
+			if (key != thumb.key) {
+				thumb.key = key;
+				thumb.ready = false;
+				thumb.failed = false;
+				enqueue(entry);
+			}
+		}
+
+		return thumb.ready ? &thumb.texture : NULL;
+	}
+
+	void update() {
+
+		if (debt > 0) {
+			// the last job overran its slice, pay it back before starting another
+			debt = std::max(0.0f, debt - budget);
+			return;
+		}
+
+		uint64_t start = ofGetElapsedTimeMicros();
+		float elapsed = 0;
+
+		while (!queue.empty() && elapsed < budget) {
+
+			Job job = queue.front();
+			queue.pop_front();
+
+			process(job);
+
+			elapsed = (ofGetElapsedTimeMicros() - start) / 1000.0f;
+		}
+
+		debt = std::max(0.0f, elapsed - budget);
+	}
+
+	// milliseconds per frame
+	float	budget = 2.0f;
+
+	int getQueueSize() { return queue.size(); }
+
+private:
+
+	struct Job {
+		string			path;
+		vector<string>	textures;
+	};
+
+	void enqueue(const ShaderIndexEntry &entry) {
+
+		for (auto it = queue.begin(); it != queue.end(); ++it) {
+			if (it->path == entry.path) {
+				queue.erase(it);
+				break;
+			}
+		}
+
+		// most recently requested, i.e. visible, goes first
+		queue.push_front((Job){entry.path, entry.textures});
+
+		if (queue.size() > THUMBNAIL_QUEUE_MAX) {
+			queue.pop_back();
+		}
+	}
+
+	void process(Job &job) {
+
+		Thumbnail &thumb = thumbnails[job.path];
+
+		string cachePath = ofFilePath::join(THUMBNAIL_DIR, Hash::toHex(thumb.key) + ".png");
+
+		if (ofFile::doesFileExist(cachePath, false) && ofLoadImage(thumb.texture, cachePath)) {
+			thumb.ready = true;
+			return;
+		}
+
+		ofShader shader;
+
+		ofLogVerbose("ThumbnailRenderer") << "Rendering " << job.path;
+
+		// compiled the way RenderEngine does, so mainImage() shaders render too
+		string source = RenderEngine::addMainImageEntry(ofBufferFromFile(job.path).getText());
+
+		if (!shader.setupShaderFromSource(GL_FRAGMENT_SHADER, source, ofFilePath::getEnclosingDirectory(job.path)) || !shader.linkProgram()) {
+			thumb.failed = true;
+			return;
+		}
+
+		map<string, ofTexture> textures;
+
+		for (auto& t : job.textures) {
+			vector<string> nameLocation = ofSplitString(t, " ");
+			// remote textures, videos and audio are skipped, they are not worth a blocking fetch here
+			if (nameLocation.size() == 2 && ofFile::doesFileExist(nameLocation[1]) &&
+				!VideoSource::isVideo(nameLocation[1]) && !AudioSource::isAudio(nameLocation[1])) {
+				ofLoadImage(textures[nameLocation[0]], nameLocation[1]);
+			}
+		}
+
+		fbo.begin();
+		{
+			ofBackground(0);
+			ofSetColor(255);
+
+			shader.begin();
+			shader.setUniform1f("u_time", THUMBNAIL_TIME);
+			shader.setUniform2f("u_resolution", THUMBNAIL_SIZE, THUMBNAIL_SIZE);
+
+			int i = 0;
+			for (auto& iter : textures) {
+				shader.setUniformTexture(iter.first, iter.second, i++);
+			}
+
+			ofDrawRectangle(0, 0, THUMBNAIL_SIZE, THUMBNAIL_SIZE);
+
+			shader.end();
+		}
+		fbo.end();
+
+		fbo.readToPixels(pixels);
+		pixels.mirror(true, false);
+
+		ofSaveImage(pixels, cachePath);
+
+		thumb.texture.loadData(pixels);
+		thumb.ready = true;
+	}
+
+	// content hash of the shader combined with the identity of its textures
+	uint64_t getKey(const ShaderIndexEntry &entry) {
+
+		uint64_t key = Hash::combine(entry.hash, THUMBNAIL_SIZE);
+		key = Hash::combine(key, THUMBNAIL_TIME);
+
+		for (auto& t : entry.textures) {
+
+			key = Hash::fnv1a(t, key);
+
+			vector<string> nameLocation = ofSplitString(t, " ");
+
+			if (nameLocation.size() == 2 && ofFile::doesFileExist(nameLocation[1])) {
+				filesystem::path p(ofToDataPath(nameLocation[1]));
+				key = Hash::combine(key, (uint64_t)filesystem::file_size(p));
+				key = Hash::combine(key, (int64_t)filesystem::last_write_time(p));
+			}
+		}
+
+		return key;
+	}
+
+	unordered_map<string, Thumbnail>	thumbnails;
+	deque<Job>							queue;
+
+	float			debt = 0;
+
+	ofFbo			fbo;
+	ofPixels		pixels;
+};
@@ -1,6 +1,5 @@
 #pragma once
 
-#include <regex>
 #include "ofMain.h"
 
 #include "ofxXmlSettings.h"
@@ -9,6 +8,8 @@
 #include "ImOf.h"
 #include "Config.h"
 #include "BaseManager.h"
+#include "RenderEngine.h"
+#include "Trace.h"
 
 #define DEFAULT_SHADER_PATH		ofToDataPath("default.frag")
 #define SEEKBAR_WIDTH			600
@@ -22,6 +23,8 @@
 
 #define REC_COLOR				0xDD4444FF
 
+#define PREVIEW_MAX_ZOOM		64.0f
+#define PREVIEW_ZOOM_STEP		1.1f	// per notch of the wheel
 
 enum TimeDisplayMode {
 	TIMECODE,
@@ -34,112 +37,33 @@ public:
 	ofEvent<int>	frameRateUpdated;
 	
 	void setup() {
-		loadShader(DEFAULT_SHADER_PATH);
+		
+		// compiled by loadPendingShader() after the first frame, like the
+		// shader of the last session that loadSettings() puts here instead
+		pendingShaderPath = DEFAULT_SHADER_PATH;
+		fileName = ofFilePath::getFileName(pendingShaderPath);
 		
 		ofAddListener(ofEvents().keyPressed, this, &GLSLManager::keyPressed);
+		ofAddListener(ofEvents().mousePressed, this, &GLSLManager::mousePressed);
+		ofAddListener(ofEvents().mouseDragged, this, &GLSLManager::mouseDragged);
+		ofAddListener(ofEvents().mouseScrolled, this, &GLSLManager::mouseScrolled);
 	}
 	
 	void loadShader(string path) {
 		
+		TRACE_SCOPE("GLSLManager::loadShader");
 		
-		static regex uniformTextureRegex("^[ \t]*uniform[ \t]+sampler2D[ \t]+([^ \t;]+)[ \t]*;[ \t]*//[ \t]*([^ \t]+)");
-		static regex urlRegex("^https?://.+$");
+		pendingShaderPath.clear();
 		
 		file.open(path);
+		fileName = file.getFileName();
+		watchedPath = file.getAbsolutePath();
 		
-		if (!file.exists()) {
-			compileSucceed = false;
-			errorMessage = "File does not exist";
-			return;
-		}
-		
-		// compile
-		ss.str("");
-		std::streambuf *old = std::cerr.rdbuf(ss.rdbuf());
-		
-		compileSucceed = shader.setupShaderFromFile(GL_FRAGMENT_SHADER, path);
+		engine.loadShader(path);
 		
-		std::cerr.rdbuf(old);
-		
-		shader.linkProgram();
-		
-		// set error message
-		if (compileSucceed) {
-			
-			ofBuffer buffer = file.readToBuffer();
-			
-			uniformTextures.clear();
-			
-			for (auto& line : buffer.getLines()) {
-				
-				static smatch m;
-				
-				if (regex_match(line, m, uniformTextureRegex)) {
-					
-					string name = m[1].str();
-					string location =  m[2].str();
-					
-					// search cached
-					map<string, ofTexture>::iterator it = cachedTextures.find(location);
-					if (it != cachedTextures.end()) {
-						// use cache
-						ofLogNotice() << "Using cached:" << location;
-						uniformTextures[name] = cachedTextures[location];
-					
-					} else {
-						
-						static ofFile textureFile;
-						ofTexture texture;
-						bool result;
-					
-						if (regex_match(location, urlRegex)) {
-							
-							ofLogNotice() << "Loading from URL:" << location;
-							ofHttpResponse response = ofLoadURL(location);
-							result = response.status == 200 && ofLoadImage(texture, response.data);
-							
-						} else {
-							
-							ofLogNotice() << "Loading from File:" << location;
-							textureFile.open(location);
-							result = textureFile.exists() && ofLoadImage(texture, location);
-						}
-						
-						if (result) {
-							uniformTextures[name] = texture;
-							cachedTextures[location] = texture;
-						} else {
-							compileSucceed = false;
-							errorMessage = "texture \"" + location + "\" does not exist";
-						}
-					}
-				}
-			}
-			
-		} else {
-			
-			// get error
-			GLuint frag = shader.getShader(GL_FRAGMENT_SHADER);
-			GLsizei infoLength;
-			
-			ofBuffer infoBuffer;
-			glGetShaderiv(frag, GL_INFO_LOG_LENGTH, &infoLength);
-			infoBuffer.allocate(infoLength);
-			glGetShaderInfoLog(frag, infoLength, &infoLength, infoBuffer.getData());
-			
-			// remove lines inserted by ofLog
-			string lines = ss.str();
-
-			static size_t pos;
-			pos = lines.find(":\n");
-			if (pos != string::npos) {
-				lines.erase(0, pos + 2);
-			}
-
-			errorMessage = infoBuffer.getText() + "\n" + lines;
+		if (file.exists()) {
+			lastModified = filesystem::last_write_time(watchedPath);
 		}
-			
-		lastModified = filesystem::last_write_time(file);
 	}
 	
 	
@@ -147,16 +71,30 @@ public:
 		
 		settings.pushTag("renderer");
 		
-		duration = settings.getValue("duration", duration);
-		frameRate = settings.getValue("frameRate", frameRate);
+		engine.setDuration(settings.getValue("duration", engine.getDuration()));
+		
+		int frameRate = settings.getValue("frameRate", engine.getFrameRate());
+		engine.setFrameRate(frameRate);
 		ofNotifyEvent(frameRateUpdated, frameRate, this);
 		
+		selectedFormat = ofClamp(settings.getValue("format", selectedFormat), 0, IM_ARRAYSIZE(targetFormats) - 1);
+		
+		engine.textureDefaults.compress = settings.getValue("textureCompress", engine.textureDefaults.compress);
+		engine.textureBudget = settings.getValue("textureBudget", engine.textureBudget);
+		engine.optimize = settings.getValue("optimize", engine.optimize);
+		engine.specialize = settings.getValue("specialize", engine.specialize);
+		regionPreview = settings.getValue("regionPreview", regionPreview);
+		engine.backend = settings.getValue("backend", 0) == 1 ? RENDER_COMPUTE : RENDER_FRAGMENT;
+		engine.computeTile[0] = settings.getValue("computeTileX", engine.computeTile[0]);
+		engine.computeTile[1] = settings.getValue("computeTileY", engine.computeTile[1]);
+		
 		int w = settings.getValue("width", 512);
 		int h = settings.getValue("height", 512);
 		setSize(w, h);
 		
-		string path = settings.getValue("shaderPath", DEFAULT_SHADER_PATH);
-		loadShader(path);
+		// compiled by loadPendingShader() once the window is up
+		pendingShaderPath = settings.getValue("shaderPath", DEFAULT_SHADER_PATH);
+		fileName = ofFilePath::getFileName(pendingShaderPath);
 		
 		settings.popTag();
 	}
@@ -166,21 +104,35 @@ public:
 		settings.addTag("renderer");
 		settings.pushTag("renderer");
 		
-		settings.setValue("duration", duration);
-		settings.setValue("frameRate", frameRate);
+		settings.setValue("duration", engine.getDuration());
+		settings.setValue("frameRate", engine.getFrameRate());
 		
-		settings.setValue("width", (int)target.getWidth());
-		settings.setValue("height", (int)target.getHeight());
+		settings.setValue("width", (int)engine.getWidth());
+		settings.setValue("height", (int)engine.getHeight());
+		settings.setValue("format", selectedFormat);
+		settings.setValue("textureCompress", engine.textureDefaults.compress);
+		settings.setValue("textureBudget", engine.textureBudget);
+		settings.setValue("optimize", engine.optimize);
+		settings.setValue("specialize", engine.specialize);
+		settings.setValue("regionPreview", regionPreview);
+		settings.setValue("backend", (int)engine.backend);
+		settings.setValue("computeTileX", engine.computeTile[0]);
+		settings.setValue("computeTileY", engine.computeTile[1]);
 		
-		settings.setValue("shaderPath", file.getAbsolutePath());
+		settings.setValue("shaderPath", pendingShaderPath.empty() ? file.getAbsolutePath() : pendingShaderPath);
 		
 		settings.popTag();
 	}
 	
+	// the shader of the last session, deferred by loadSettings()
+	void loadPendingShader() {
+		if (!pendingShaderPath.empty()) {
+			loadShader(pendingShaderPath);
+		}
+	}
+	
 	void setSize(int w, int h) {
-		
-		target.allocate(w, h, GL_RGB);
-		renderFbo.allocate(w, h, GL_RGB);
+		engine.allocate(w, h, selectedFormat);
 		targetSize[0] = w;
 		targetSize[1] = h;
 	}
@@ -195,11 +147,16 @@ public:
 	
 	void update() {
 		
-		if (file.exists()) {
+		TRACE_SCOPE("GLSLManager::update");
+		
+		// ofFile builds a path string on every call, the watched path does not
+		if (filesystem::exists(watchedPath)) {
+			TRACE_SCOPE("stat");
 			static int lm;
-			lm = filesystem::last_write_time(file);
+			lm = filesystem::last_write_time(watchedPath);
 			
-			if (lm != lastModified) {
+			// picked up once the export is done, it may change the outputs
+			if (lm != lastModified && !isRecording) {
 				reloadShader();
 			}
 		}
@@ -214,16 +171,26 @@ public:
 		prevElapsedTime = elapsedTime;
 		
 		// frame
+		int frameRate = engine.getFrameRate();
+		
 		if (isPlaying && !isRecording) {
-			currentTime = fmod(currentTime + deltaTime, (float)duration / frameRate);
+			currentTime = fmod(currentTime + deltaTime, (float)engine.getDuration() / frameRate);
 		}
 		
-		renderFrame(currentTime * frameRate);
+		renderPreview(currentTime * frameRate);
 		
 		// reload display
 		remainingReloadDisplayTime = std::max(0.0f, remainingReloadDisplayTime - deltaTime);
 		
 		// update timecode
+		int lastRenderedFrame = engine.getLastRenderedFrame();
+		
+		if (lastRenderedFrame == formattedFrame && timeDisplayMode == formattedMode) {
+			return;
+		}
+		formattedFrame = lastRenderedFrame;
+		formattedMode = timeDisplayMode;
+		
 		if (timeDisplayMode == TIMECODE) {
 			static int seconds, minutes;
 			seconds = lastRenderedFrame / frameRate;
@@ -238,32 +205,21 @@ public:
 		
 		ofSetColor(255);
 		
-		if (compileSucceed) {
+		if (engine.isCompiled() && previewScreen.width > 0 && previewScreen.height > 0) {
 			ofPushMatrix();
 			{
-				static float screenW, screenH, w, h, sx, sy, s, tx, ty, fw, fh;
-				
-				screenW = ofGetWidth() - GUI_WIDTH;
-				screenH = ofGetHeight();
+				static float fw, fh;
 				
-				w = target.getWidth();
-				h = target.getHeight();
+				fw = previewScreen.width;
+				fh = previewScreen.height;
 				
-				sx = screenW / w;
-				sy = screenH / h;
-				
-				s = min(sx, sy);
-				
-				tx = (screenW - w * s) * .5;
-				ty = (screenH - h * s) * .5;
-				
-				fw = w * s;
-				fh = h * s;
-				
-				ofTranslate(GUI_WIDTH + tx, ty + h * s);
+				ofTranslate(previewScreen.x, previewScreen.y + fh);
 				
 				ofScale(1, -1);
-				target.draw(0, 0, fw, fh);
+				
+				int output = min(previewOutput, engine.getNumOutputs() - 1);
+				ofTexture &texture = regionRendered ? engine.getRegionTexture(output) : engine.getTexture(output);
+				texture.drawSubsection(0, 0, fw, fh, previewSource.x, previewSource.y, previewSource.width, previewSource.height);
 				
 				if (remainingReloadDisplayTime > 0 || isRecording) {
 					ofPushStyle();
@@ -290,6 +246,101 @@ public:
 	
 	char* getTimeText() { return timeText; }
 	
+	// duration, size, format, outputs, optimizer and backend
+	void drawRenderSettings() {
+		
+		int duration = engine.getDuration();
+		if (ImGui::DragInt("Duration", &duration, 1.0f, 1, 9000, "%.0fF")) {
+			engine.setDuration(duration);
+		}
+		
+		int frameRate = engine.getFrameRate();
+		if (ImGui::SliderInt("Frame Rate", &frameRate, 8, 60)) {
+			engine.setFrameRate(frameRate);
+			ofNotifyEvent(frameRateUpdated, frameRate, this);
+		}
+		
+		ImGui::DragInt2("", targetSize, 1.0f, 4, 4096);
+		ImGui::SameLine();
+		
+		if (engine.getWidth() != targetSize[0] || engine.getHeight() != targetSize[1] || engine.getFormat() != selectedFormat) {
+			if (ImGui::Button("Update Size", ImVec2(-1, 0))) {
+				setSize(targetSize[0], targetSize[1]);
+			}
+		} else {
+			ImGui::Text("Size");
+		}
+		
+		static const char** formatLabels = [] {
+			static const char* labels[IM_ARRAYSIZE(targetFormats)];
+			for (int i = 0; i < IM_ARRAYSIZE(targetFormats); i++) {
+				labels[i] = targetFormats[i].label.c_str();
+			}
+			return labels;
+		}();
+		
+		ImGui::Combo("Format", &selectedFormat, formatLabels, IM_ARRAYSIZE(targetFormats));
+		
+		// every output is exported, one is previewed
+		if (engine.getNumOutputs() > 1) {
+			previewOutput = min(previewOutput, engine.getNumOutputs() - 1);
+			ImGui::Combo("Output", &previewOutput, [](void *data, int i, const char **label) {
+				*label = ((RenderEngine*)data)->getOutputName(i).c_str();
+				return true;
+			}, &engine, engine.getNumOutputs());
+		}
+		
+		// optimizer
+		if (ImGui::Checkbox("Optimize", &engine.optimize)) {
+			reloadShader();
+		}
+		
+		if (engine.optimize && engine.isCompiled()) {
+			
+			ImGui::SameLine();
+			if (ImGui::Button("A/B Benchmark", ImVec2(-1, 0))) {
+				engine.runBenchmark();
+			}
+			
+			ImGui::TextWrapped("%s", engine.getOptimizeLog().c_str());
+			
+			const ShaderBenchmark *benchmark = engine.getBenchmark();
+			if (benchmark) {
+				ImGui::Text("%.2fms / %.2fms optimized", benchmark->original, benchmark->optimized);
+			}
+			ImGui::TextDisabled("Using the %s shader", engine.isUsingOptimized() ? "optimized" : "original");
+		}
+		
+		ImGui::Checkbox("Specialize on Export", &engine.specialize);
+		
+		// backend, compute is only offered where the context has it
+		if (RenderEngine::isComputeSupported() && engine.isCompiled()) {
+			
+			static const char* backendLabels[] = {"Fragment", "Compute"};
+			int backend = engine.backend;
+			if (ImGui::Combo("Backend", &backend, backendLabels, IM_ARRAYSIZE(backendLabels))) {
+				engine.backend = (RenderBackend)backend;
+			}
+			
+			if (engine.backend == RENDER_COMPUTE) {
+				ImGui::DragInt2("Tile", engine.computeTile, 0.2f, 1, 1024);
+				
+				if (engine.getActiveBackend() != RENDER_COMPUTE) {
+					ImGui::TextWrapped("%s", engine.getComputeLog().c_str());
+				}
+			}
+			
+			if (ImGui::Button("Compare Backends", ImVec2(-1, 0))) {
+				engine.runBackendBenchmark();
+			}
+			
+			const BackendBenchmark *benchmark = engine.getBackendBenchmark();
+			if (benchmark) {
+				ImGui::Text("%.2fms / %.2fms compute %dx%d", benchmark->fragment, benchmark->compute, benchmark->tile[0], benchmark->tile[1]);
+			}
+		}
+	}
+	
 	void drawImGui() {
 	
 		static bool isOpen = true;
@@ -298,7 +349,7 @@ public:
 		
 		if ((isOpen = ImGui::CollapsingHeader("Renderer"))) {
 			
-			if (ImGui::Button(file.getFileName().c_str(), ImVec2(-1, 30))) {
+			if (ImGui::Button(fileName.c_str(), ImVec2(-1, 30))) {
 				#ifdef TARGET_OSX
 				ofSystem("open " + file.getAbsolutePath());
 				#endif
@@ -306,28 +357,63 @@ public:
 			
 			// render settings
 			ImGui::PushItemWidth(-100);
-			ImGui::DragInt("Duration", &duration, 1.0f, 1, 9000, "%.0fF");
-			
-			if (ImGui::SliderInt("Frame Rate", &frameRate, 8, 60)) {
-				ofNotifyEvent(frameRateUpdated, frameRate, this);
+			// the export reads back into buffers sized for the current target,
+			// so nothing that changes the target or the shader is offered
+			if (isRecording) {
+				ImGui::TextDisabled("%dx%d %s, locked while exporting", (int)engine.getWidth(), (int)engine.getHeight(),
+					targetFormats[engine.getFormat()].label.c_str());
+			} else {
+				drawRenderSettings();
 			}
 			
-			ImGui::DragInt2("", targetSize, 1.0f, 4, 4096);
+			// preview
+			ImGui::Checkbox("Region Preview", &regionPreview);
 			ImGui::SameLine();
+			ImGui::TextDisabled("%.0f%%", getPreviewScale() * 100);
 			
-			if (target.getWidth() != targetSize[0] || target.getHeight() != targetSize[1]) {
-				if (ImGui::Button("Update Size", ImVec2(-1, 0))) {
-					setSize(targetSize[0], targetSize[1]);
+			if (zoom != 1.0f || viewCenter != ofVec2f(0.5f, 0.5f)) {
+				ImGui::SameLine();
+				if (ImGui::Button("Fit", ImVec2(-1, 0))) {
+					resetView();
 				}
-			} else {
-				ImGui::Text("Size");
+			}
+			
+			// textures
+			if (!engine.getTextures().empty() && ImGui::TreeNode("Textures")) {
+				
+				if (!isRecording) {
+					
+					if (ImGui::Checkbox("Compress", &engine.textureDefaults.compress)) {
+						reloadShader();
+					}
+					
+					int &textureBudget = engine.textureBudget;
+					if (ImGui::DragInt("Budget", &textureBudget, 8.0f, 0, 16384, textureBudget > 0 ? "%.0fMB" : "Unlimited")) {
+						engine.applyTextureBudget();
+					}
+				}
+				
+				size_t total = 0;
+				
+				for (auto& iter : engine.getTextures()) {
+					ofTexture &texture = iter.second->getTexture();
+					ImGui::Text("%s", iter.first.c_str());
+					ImGui::SameLine();
+					ImGui::TextDisabled("%dx%d %s %.1fMB", (int)texture.getWidth(), (int)texture.getHeight(),
+						iter.second->getFormatName(), iter.second->getMemory() / (1024.0f * 1024.0f));
+					total += iter.second->getMemory();
+				}
+				
+				ImGui::TextDisabled("Total %.1fMB", total / (1024.0f * 1024.0f));
+				ImGui::TreePop();
 			}
 			
 			ImGui::PopItemWidth();
 			ImGui::Separator();
 		}
 		
-		if (!compileSucceed) {
+		// nothing is compiled yet before the pending shader is loaded
+		if (!engine.isCompiled() && pendingShaderPath.empty()) {
 			
 			ImGui::PushStyleVar(ImGuiStyleVar_WindowRounding, 2);
 			ImGui::PushStyleColor(ImGuiCol_WindowBg, ImVec4(0, 0, 0, 0));
@@ -337,7 +423,7 @@ public:
 			ImGui::SetNextWindowSize(ImVec2(ofGetWidth() - GUI_WIDTH, ofGetHeight()));
 			ImGui::Begin("", NULL, ImVec2(0,0), -1.0f, ImGuiWindowFlags_AlwaysAutoResize | ImGuiWindowFlags_NoMove | ImGuiWindowFlags_NoTitleBar);
 			{
-				ImGui::Text("%s", errorMessage.c_str());
+				ImGui::Text("%s", engine.getErrorMessage().c_str());
 			}
 			ImGui::End();
 			
@@ -353,7 +439,7 @@ public:
 		static bool mouseOnCanvas;
 		mouseOnCanvas = shaderArea.inside(ofGetMouseX(), ofGetMouseY());
 		
-		if (compileSucceed && (isRecording || mouseOnCanvas)) {
+		if (engine.isCompiled() && (isRecording || mouseOnCanvas)) {
 			float ww = min(ofGetWidth() - GUI_WIDTH - SEEKBAR_MARGIN * 2, SEEKBAR_WIDTH);
 			
 			ImVec2 pos( (GUI_WIDTH + ofGetWidth()) / 2.0f - ww / 2.0f, ofGetHeight() - SEEKBAR_HEIGHT - SEEKBAR_MARGIN);
@@ -386,12 +472,12 @@ public:
 				
 				// seek bar
 				static int frame = 0;
-				frame = lastRenderedFrame;
+				frame = engine.getLastRenderedFrame();
 				
 				ImGui::SameLine();
-				if (ImOf::Seekbar("###Seekbar", &frame, 0, duration - 1, ImVec2(-SEEKBAR_TIME_WIDTH, -1)) && !isRecording) {
+				if (ImOf::Seekbar("###Seekbar", &frame, 0, engine.getDuration() - 1, ImVec2(-SEEKBAR_TIME_WIDTH, -1)) && !isRecording) {
 					isPlaying = false;
-					currentTime = (float)frame / frameRate;
+					currentTime = (float)frame / engine.getFrameRate();
 				}
 				
 				// timecode
@@ -412,64 +498,128 @@ public:
 		}
 	}
 	
-	float getWidth()	{ return target.getWidth(); }
-	float getHeight()	{ return target.getHeight(); }
-	int getFrameRate()	{ return frameRate; }
-	int getDuration()	{ return duration; }
+	RenderEngine& getEngine() { return engine; }
 	
-	void readToPixelsAtFrame(int frame, ofPixels &pixels) {
-		renderFrame(frame);
-		
-		// fix vertical flip
-		renderFbo.begin();
-		ofPushMatrix();
-		{
-			ofBackground(0);
-			ofSetColor(255);
-			
-			ofTranslate(0, target.getHeight());
-			ofScale(1, -1);
-			target.draw(0, 0);
-		}
-		ofPopMatrix();
-		renderFbo.end();
-		
-		renderFbo.readToPixels(pixels);
+private:
+	
+	void reloadShader() {
+		remainingReloadDisplayTime = RELOAD_DISPLAY_DURATION;
+		loadShader(file.getAbsolutePath());
 	}
 	
-private:
+	// the window area right of the GUI
+	ofRectangle getCanvas() {
+		return ofRectangle(GUI_WIDTH, 0, ofGetWidth() - GUI_WIDTH, ofGetHeight());
+	}
+	
+	// screen pixels per target pixel, 1 for zoom fits the frame in the canvas
+	float getPreviewScale() {
+		ofRectangle canvas = getCanvas();
+		return min(canvas.width / engine.getWidth(), canvas.height / engine.getHeight()) * zoom;
+	}
+	
+	// where the whole frame is on screen, viewCenter at the canvas center
+	ofRectangle getFrameRect() {
+		ofRectangle canvas = getCanvas();
+		float s = getPreviewScale();
+		float w = engine.getWidth() * s, h = engine.getHeight() * s;
+		return ofRectangle(canvas.getCenter().x - viewCenter.x * w, canvas.getCenter().y - viewCenter.y * h, w, h);
+	}
 	
-	void renderFrame(int frame) {
+	void resetView() {
+		zoom = 1.0f;
+		viewCenter.set(0.5f, 0.5f);
+	}
+	
+	// Renders the frame for draw(). With region preview on only the visible
+	// part is rendered, one pixel per screen pixel but never finer than the
+	// target, and the whole frame otherwise. Nothing is rendered while
+	// recording, the export renders into the same target and its frames are
+	// shown instead.
+	void renderPreview(int frame) {
 		
-		static float time;
-		time = (float)frame / frameRate;
+		ofRectangle frameRect = getFrameRect();
+		previewScreen = frameRect.getIntersection(getCanvas());
 		
-		target.begin();
-		{
-			ofBackground(0);
-			ofSetColor(255);
-			
-			shader.begin();
-			shader.setUniform1f("u_time", time);
-			shader.setUniform2f("u_resolution", target.getWidth(), target.getHeight());
+		float s = frameRect.width / engine.getWidth();
+		float w = engine.getWidth(), h = engine.getHeight();
+		
+		// the visible part in target pixels from the bottom left, like the texture
+		ofRectangle visible((previewScreen.x - frameRect.x) / s, h - (previewScreen.getBottom() - frameRect.y) / s,
+							previewScreen.width / s, previewScreen.height / s);
+		
+		regionRendered = false;
+		
+		if (isRecording) {
+			// a second frame requested every update would move the decode
+			// window of movie inputs back and forth
+			previewSource = visible;
+			return;
+		}
+		
+		if (regionPreview && previewScreen.width >= 1 && previewScreen.height >= 1) {
 			
-			int i = 0;
-			for (const auto iter : uniformTextures) {
-				shader.setUniformTexture(iter.first, iter.second, i++);
-			}
+			// widened to whole target pixels, so gl_FragCoord lands on the
+			// same pixel centers as in the full frame at 100% and above
+			float x0 = max(0.0f, floorf(visible.x)), y0 = max(0.0f, floorf(visible.y));
+			float x1 = min(w, ceilf(visible.getRight())), y1 = min(h, ceilf(visible.getBottom()));
 			
-			ofDrawRectangle(0, 0, target.getWidth(), target.getHeight());
+			float step = max(1.0f, 1.0f / s);
+			int rw = ceilf((x1 - x0) / step), rh = ceilf((y1 - y0) / step);
 			
-			shader.end();
+			if (engine.renderRegion(frame, ofRectangle(x0, y0, x1 - x0, y1 - y0), rw, rh)) {
+				float sx = rw / (x1 - x0), sy = rh / (y1 - y0);
+				previewSource.set((visible.x - x0) * sx, (visible.y - y0) * sy, visible.width * sx, visible.height * sy);
+				regionRendered = true;
+				return;
+			}
 		}
-		target.end();
 		
-		lastRenderedFrame = frame;
+		engine.renderFrame(frame);
+		previewSource = visible;
 	}
 	
-	void reloadShader() {
-		remainingReloadDisplayTime = RELOAD_DISPLAY_DURATION;
-		loadShader(file.getAbsolutePath());
+	bool isOnCanvas(int x, int y) {
+		return getCanvas().inside(x, y) && !ImGui::GetIO().WantCaptureMouse;
+	}
+	
+	void mousePressed(ofMouseEventArgs & args) {
+		dragFrom.set(args.x, args.y);
+		isDragging = isOnCanvas(args.x, args.y);
+	}
+	
+	// pans by dragging the frame
+	void mouseDragged(ofMouseEventArgs & args) {
+		
+		if (!isDragging) {
+			return;
+		}
+		
+		ofRectangle frameRect = getFrameRect();
+		viewCenter.x = ofClamp(viewCenter.x - (args.x - dragFrom.x) / frameRect.width, 0, 1);
+		viewCenter.y = ofClamp(viewCenter.y - (args.y - dragFrom.y) / frameRect.height, 0, 1);
+		dragFrom.set(args.x, args.y);
+	}
+	
+	// zooms around the point under the cursor
+	void mouseScrolled(ofMouseEventArgs & args) {
+		
+		if (!isOnCanvas(args.x, args.y) || args.scrollY == 0) {
+			return;
+		}
+		
+		ofRectangle before = getFrameRect();
+		ofVec2f point((args.x - before.x) / before.width, (args.y - before.y) / before.height);
+		
+		zoom = ofClamp(zoom * powf(PREVIEW_ZOOM_STEP, args.scrollY), 1.0f, PREVIEW_MAX_ZOOM);
+		
+		ofRectangle after = getFrameRect();
+		viewCenter.x = ofClamp(viewCenter.x + point.x - (args.x - after.x) / after.width, 0, 1);
+		viewCenter.y = ofClamp(viewCenter.y + point.y - (args.y - after.y) / after.height, 0, 1);
+		
+		if (zoom == 1.0f) {
+			resetView();
+		}
 	}
 	
 	void keyPressed(ofKeyEventArgs & args) {
@@ -478,6 +628,7 @@ private:
 			return;
 		}
 		
+		int duration = engine.getDuration(), frameRate = engine.getFrameRate();
 		float frameDuration = 1.0f / frameRate;
 		
 		switch (args.key) {
@@ -485,10 +636,13 @@ private:
 				isPlaying = !isPlaying;
 				break;
 			case 'r':
-				cachedTextures.clear();
+				engine.clearCaches();
 				ofLogNotice() << "textures cleared";
 				reloadShader();
 				break;
+			case 'f':
+				resetView();
+				break;
 			case OF_KEY_LEFT:
 				isPlaying = false;
 				currentTime = max((float)currentTime - frameDuration, 0.0f);
@@ -501,37 +655,38 @@ private:
 	}
 	
 	
-	map<string, ofTexture>	uniformTextures;
-	map<string, ofTexture>	cachedTextures;
-	
-	ofFbo			renderFbo; // to fix vertical flip when rendering
-	
-	stringstream	ss;
-	string			errorMessage;
+	RenderEngine	engine;
 	
 	char			timeText[128];
+	int				formattedFrame = -1;
+	TimeDisplayMode	formattedMode = FRAMES;
 	
 	float			remainingReloadDisplayTime = 0.0f;
 	
-	int				duration = 120;
-	int				frameRate = 30;
-	
 	float			currentTime = 0;
 	
-	int				lastRenderedFrame = 0;
-	
-	bool			compileSucceed;
 	TimeDisplayMode	timeDisplayMode = FRAMES;
 	bool			isPlaying = true;
 	bool			isRecording = false;
 	
 	int				targetSize[2];
+	int				selectedFormat = 0;
+	int				previewOutput = 0;
+	
+	bool			regionPreview = false;
+	bool			regionRendered = false;
+	float			zoom = 1.0f;
+	ofVec2f			viewCenter = ofVec2f(0.5f, 0.5f);	// of the frame, 0-1 from the top left
+	ofVec2f			dragFrom;
+	bool			isDragging = false;
+	ofRectangle		previewScreen;		// where the frame is drawn, clipped to the canvas
+	ofRectangle		previewSource;		// the part of the texture drawn there
 	
 	int				lastModified;
 	
 	ofFile			file;
-	
-	ofShader		shader;
-	ofFbo			target;
+	string			fileName;
+	string			pendingShaderPath;
+	filesystem::path	watchedPath;
 	
 };
@@ -8,6 +8,12 @@
 #include "ImOf.h"
 #include "Config.h"
 #include "BaseManager.h"
+#include "ShaderIndex.h"
+#include "ThumbnailRenderer.h"
+#include "Trace.h"
+
+#define FILE_LIST_ROWS		12
+#define THUMBNAIL_CELL		72
 
 class ShaderFileManager : public BaseManager {
 public:
@@ -15,42 +21,20 @@ public:
 	ofEvent<string> shaderFileSelected;
 	
 	void setup() {
-		watchDir.allowExt("frag");
-		watchDir.allowExt("fs");
+		thumbnails.setup();
 	}
 	
 	void setWatchDirectory(string path) {
 		
-		watchDir.open(path);
-		
-		if (!watchDir.exists()) {
+		if (!ofDirectory::doesDirectoryExist(path, false)) {
 			ofFilePath filePath;
-			watchDir.open( filePath.getUserHomeDir() );
+			path = filePath.getUserHomeDir();
 		}
 		
-		watchDir.listDir();
-		
-		size_t numFiles = watchDir.size();
-		
-		if (numFiles == 0) {
-			
-			string empty = "(No Shader Files)";
-			
-			fileNames = new char*[1];
-			fileNames[0] = new char[empty.size() + 1];
-			strcpy(fileNames[0], empty.c_str());
-			
-		} else {
-			fileNames = new char*[numFiles];
-			
-			for (int i = 0; i < numFiles; i++) {
-				string name = watchDir.getName(i);
-				fileNames[i] = new char[name.size() + 1];
-				strcpy(fileNames[i], name.c_str());
-			}
-		}
+		watchPath = ofFilePath::getAbsolutePath(path, false);
 		
-		lastModified = filesystem::last_write_time(watchDir);
+		index.open(watchPath);
+		filteredRevision = -1;
 	}
 	
 	
@@ -58,9 +42,11 @@ public:
 		
 		settings.pushTag("shaderFile");
 		
+		string path = settings.getValue("watchPath", "");
+		setWatchDirectory(path);
 		
-		string watchPath = settings.getValue("watchPath", "");
-		setWatchDirectory(watchPath);
+		showThumbnails = settings.getValue("showThumbnails", showThumbnails);
+		thumbnails.budget = settings.getValue("thumbnailBudget", thumbnails.budget);
 		
 		settings.popTag();
 	}
@@ -70,20 +56,23 @@ public:
 		settings.addTag("shaderFile");
 		settings.pushTag("shaderFile");
 		
-		settings.setValue("watchPath", watchDir.getAbsolutePath());
+		settings.setValue("watchPath", watchPath);
+		settings.setValue("showThumbnails", showThumbnails);
+		settings.setValue("thumbnailBudget", thumbnails.budget);
 		
 		settings.popTag();
 	}
 	
 	void update() {
 		
-		if (watchDir.exists()) {
-			static int lm;
-			lm = filesystem::last_write_time(watchDir);
-			
-			if (lm != lastModified) {
-				reloadDirectory();
-			}
+		TRACE_SCOPE("ShaderFileManager::update");
+		
+		if (filteredRevision != index.getRevision()) {
+			updateFiltered();
+		}
+		
+		if (showThumbnails) {
+			thumbnails.update();
 		}
 	}
 	
@@ -110,21 +99,30 @@ public:
 			ImGui::SameLine();
 			if (ImGui::Button("Open")) {
 				#ifdef TARGET_OSX
-				ofSystem("open " + watchDir.getAbsolutePath());
+				ofSystem("open " + watchPath);
 				#endif
 			}
-		
-			const char **cNames = const_cast<const char**>(fileNames);
 			
 			ImGui::PushItemWidth(-1);
-			if (ImGui::ListBox("", &selected, cNames, watchDir.size() == 0 ? 1 : watchDir.size(), 7)) {
-				
-				if (selected < watchDir.size()) {
-					string path = watchDir.getPath(selected);
-					ofNotifyEvent(shaderFileSelected, path, this);
-				}
+			if (ImGui::InputText("###Search", query, IM_ARRAYSIZE(query))) {
+				updateFiltered();
 			}
 			ImGui::PopItemWidth();
+			
+			if (showThumbnails) {
+				drawThumbnailGrid();
+			} else {
+				drawFileList();
+			}
+			
+			ImGui::Checkbox("Thumbnails", &showThumbnails);
+			
+			if (showThumbnails) {
+				ImGui::SameLine();
+				ImGui::PushItemWidth(-1);
+				ImGui::DragFloat("###ThumbnailBudget", &thumbnails.budget, 0.1f, 0.1f, 16.0f, "%.1fms/frame");
+				ImGui::PopItemWidth();
+			}
 		
 		ImGui::Separator();
 		}
@@ -133,7 +131,123 @@ public:
 private:
 	
 	void reloadDirectory() {
-		setWatchDirectory(watchDir.getAbsolutePath());
+		index.rescan();
+	}
+	
+	// re-run the fuzzy search over the latest snapshot
+	void updateFiltered() {
+		
+		entries = index.getEntries(&filteredRevision);
+		
+		static vector<pair<int, int>> scored;
+		scored.clear();
+		
+		for (int i = 0; i < entries->size(); i++) {
+			int score = ShaderIndex::fuzzyScore(query, (*entries)[i].name);
+			if (score >= 0) {
+				scored.push_back(make_pair(-score, i));
+			}
+		}
+		
+		// stable so that equally scored files stay in path order
+		stable_sort(scored.begin(), scored.end(), [](const pair<int, int> &a, const pair<int, int> &b) {
+			return a.first < b.first;
+		});
+		
+		filtered.resize(scored.size());
+		for (int i = 0; i < scored.size(); i++) {
+			filtered[i] = scored[i].second;
+		}
+	}
+	
+	// only the visible rows are submitted to ImGui
+	void drawFileList() {
+		
+		const float lineHeight = ImGui::GetTextLineHeightWithSpacing();
+		
+		ImGui::BeginChild("###Files", ImVec2(-1, lineHeight * FILE_LIST_ROWS + ImGui::GetStyle().WindowPadding.y * 2), true);
+		
+		if (filtered.empty()) {
+			ImGui::TextDisabled("%s", index.isScanning() ? "(Scanning...)" : "(No Shader Files)");
+		}
+		
+		ImGuiListClipper clipper(filtered.size(), lineHeight);
+		
+		for (int i = clipper.DisplayStart; i < clipper.DisplayEnd; i++) {
+			
+			const ShaderIndexEntry &entry = (*entries)[filtered[i]];
+			
+			ImGui::PushID(filtered[i]);
+			if (ImGui::Selectable(entry.name.c_str(), entry.path == selectedPath)) {
+				selectedPath = entry.path;
+				string path = selectedPath;
+				ofNotifyEvent(shaderFileSelected, path, this);
+			}
+			ImGui::PopID();
+		}
+		
+		clipper.End();
+		
+		ImGui::EndChild();
+		
+		ImGui::TextDisabled("%d / %d files", (int)filtered.size(), (int)entries->size());
+	}
+	
+	// rows of thumbnails, also clipped to the visible ones
+	void drawThumbnailGrid() {
+		
+		const ImGuiStyle &style = ImGui::GetStyle();
+		const float cellHeight = THUMBNAIL_CELL + style.ItemSpacing.y;
+		
+		ImGui::BeginChild("###Thumbnails", ImVec2(-1, cellHeight * 3 + style.WindowPadding.y * 2), true);
+		
+		int columns = std::max(1, (int)((ImGui::GetContentRegionAvailWidth() + style.ItemSpacing.x) / (THUMBNAIL_CELL + style.ItemSpacing.x)));
+		int rows = (filtered.size() + columns - 1) / columns;
+		
+		ImGuiListClipper clipper(rows, cellHeight);
+		
+		for (int row = clipper.DisplayStart; row < clipper.DisplayEnd; row++) {
+			for (int col = 0; col < columns; col++) {
+				
+				int i = row * columns + col;
+				if (i >= filtered.size()) {
+					break;
+				}
+				
+				const ShaderIndexEntry &entry = (*entries)[filtered[i]];
+				ofTexture *texture = thumbnails.get(entry);
+				
+				if (col > 0) {
+					ImGui::SameLine();
+				}
+				
+				ImGui::PushID(filtered[i]);
+				
+				bool clicked;
+				if (texture) {
+					ImTextureID id = (ImTextureID)(uintptr_t)texture->getTextureData().textureID;
+					clicked = ImGui::ImageButton(id, ImVec2(THUMBNAIL_CELL - 4, THUMBNAIL_CELL - 4), ImVec2(0, 0), ImVec2(1, 1), 2);
+				} else {
+					clicked = ImGui::Button("...", ImVec2(THUMBNAIL_CELL, THUMBNAIL_CELL));
+				}
+				
+				if (ImGui::IsItemHovered()) {
+					ImGui::SetTooltip("%s", entry.name.c_str());
+				}
+				
+				if (clicked) {
+					selectedPath = entry.path;
+					string path = selectedPath;
+					ofNotifyEvent(shaderFileSelected, path, this);
+				}
+				
+				ImGui::PopID();
+			}
+		}
+		
+		clipper.End();
+		
+		ImGui::EndChild();
 	}
 	
 	void duplicateSelected(bool alreadyExists = false) {
@@ -144,7 +258,7 @@ private:
 			return;
 		}
 		
-		string newPath = watchDir.getAbsolutePath() + "/" + newName + ".frag";
+		string newPath = ofFilePath::join(ofFilePath::getEnclosingDirectory(selectedPath), newName + ".frag");
 		ofFile duplicated(newPath);
 		
 		if (duplicated.exists()) {
@@ -156,7 +270,7 @@ private:
 		duplicated.create();
 		
 		ofBuffer buffer;
-		ofFile original(watchDir.getPath(selected));
+		ofFile original(selectedPath);
 		buffer = original.readToBuffer();
 		
 		duplicated.setWriteable(true);
@@ -173,11 +287,15 @@ private:
 		
 	}
 	
-	stringstream	ss;
+	string			watchPath;
+	string			selectedPath;
 	
-	int				lastModified;
-	int				selected = -1;
-	char			**fileNames;
+	ShaderIndex		index;
+	ThumbnailRenderer	thumbnails;
+	bool			showThumbnails = false;
 	
-	ofDirectory		watchDir;
+	shared_ptr<const ShaderIndexEntries>	entries = make_shared<ShaderIndexEntries>();
+	vector<int>		filtered;
+	int				filteredRevision = -1;
+	char			query[128] = "";
 };
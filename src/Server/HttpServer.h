@@ -0,0 +1,327 @@
+#pragma once
+
+#include <thread>
+#include <atomic>
+#include <functional>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <poll.h>
+#include <unistd.h>
+#include "ofMain.h"
+
+#define HTTP_REQUEST_TIMEOUT	5000	// ms for a client to send its whole request
+#define HTTP_REQUEST_MAX		(16 * 1024 * 1024)	// bytes of headers and body, inline sources included
+
+// a client that hangs up before reading the reply must not raise SIGPIPE
+#ifdef MSG_NOSIGNAL
+#define HTTP_SEND_FLAGS			MSG_NOSIGNAL
+#else
+#define HTTP_SEND_FLAGS			0
+#endif
+
+struct HttpRequest {
+	string				method;
+	string				path;
+	map<string, string>	params;		// query string and form encoded body
+	string				body;
+};
+
+struct HttpResponse {
+	int		status = 200;
+	string	contentType = "application/json";
+	string	body;
+};
+
+// Just enough HTTP/1.0 for the render server's API: one request per
+// connection, bound to localhost and optionally to a unix socket. Requests
+// are handled one at a time on the server thread, so a client that stops
+// sending is cut off after HTTP_REQUEST_TIMEOUT. Browsers send an Origin
+// header with every cross-site POST, so requests carrying one are refused:
+// a web page must not be able to submit jobs to a local daemon.
+
+class HttpServer {
+public:
+
+	typedef function<HttpResponse(const HttpRequest&)> Handler;
+
+	~HttpServer() {
+		stop();
+	}
+
+	bool start(int port, string socketPath, Handler h) {
+
+		handler = h;
+
+		if (port > 0) {
+
+			int fd = socket(AF_INET, SOCK_STREAM, 0);
+			int yes = 1;
+			setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &yes, sizeof(yes));
+
+			sockaddr_in addr;
+			memset(&addr, 0, sizeof(addr));
+			addr.sin_family = AF_INET;
+			addr.sin_port = htons(port);
+			addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+			if (!listenOn(fd, (sockaddr*)&addr, sizeof(addr))) {
+				ofLogError("HttpServer") << "Failed to listen on 127.0.0.1:" << port;
+				return false;
+			}
+			ofLogNotice("HttpServer") << "Listening on http://127.0.0.1:" << port;
+		}
+
+		if (!socketPath.empty()) {
+
+			unlink(socketPath.c_str());
+
+			int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+
+			sockaddr_un addr;
+			memset(&addr, 0, sizeof(addr));
+			addr.sun_family = AF_UNIX;
+			strncpy(addr.sun_path, socketPath.c_str(), sizeof(addr.sun_path) - 1);
+
+			if (!listenOn(fd, (sockaddr*)&addr, sizeof(addr))) {
+				ofLogError("HttpServer") << "Failed to listen on " << socketPath;
+				return false;
+			}
+			unixSocketPath = socketPath;
+			ofLogNotice("HttpServer") << "Listening on " << socketPath;
+		}
+
+		running = true;
+		thread = std::thread(&HttpServer::threadedFunction, this);
+
+		return true;
+	}
+
+	void stop() {
+
+		running = false;
+
+		if (thread.joinable()) {
+			thread.join();
+		}
+
+		for (int fd : listeners) {
+			::close(fd);
+		}
+		listeners.clear();
+
+		if (!unixSocketPath.empty()) {
+			unlink(unixSocketPath.c_str());
+			unixSocketPath.clear();
+		}
+	}
+
+	static string urlDecode(const string &str) {
+		string result;
+		for (size_t i = 0; i < str.size(); i++) {
+			if (str[i] == '+') {
+				result += ' ';
+			} else if (str[i] == '%' && i + 2 < str.size()) {
+				result += (char)strtol(str.substr(i + 1, 2).c_str(), NULL, 16);
+				i += 2;
+			} else {
+				result += str[i];
+			}
+		}
+		return result;
+	}
+
+	static string jsonEscape(const string &str) {
+		string result;
+		for (char c : str) {
+			switch (c) {
+				case '"':	result += "\\\""; break;
+				case '\\':	result += "\\\\"; break;
+				case '\n':	result += "\\n"; break;
+				default:	result += c;
+			}
+		}
+		return result;
+	}
+
+private:
+
+	bool listenOn(int fd, sockaddr *addr, socklen_t length) {
+
+		if (fd < 0 || ::bind(fd, addr, length) < 0 || listen(fd, 16) < 0) {
+			if (fd >= 0) {
+				::close(fd);
+			}
+			return false;
+		}
+
+		listeners.push_back(fd);
+		return true;
+	}
+
+	void threadedFunction() {
+
+		vector<pollfd> fds;
+		for (int fd : listeners) {
+			fds.push_back((pollfd){fd, POLLIN, 0});
+		}
+
+		while (running) {
+
+			// wake up regularly to notice stop()
+			if (poll(fds.data(), fds.size(), 200) <= 0) {
+				continue;
+			}
+
+			for (auto& p : fds) {
+				if (p.revents & POLLIN) {
+					int client = accept(p.fd, NULL, NULL);
+					if (client >= 0) {
+						handleConnection(client);
+						::close(client);
+					}
+				}
+			}
+		}
+	}
+
+	void handleConnection(int fd) {
+
+		string data;
+		char chunk[4096];
+		size_t headerEnd = string::npos;
+		size_t contentLength = 0;
+		bool timedOut = false;
+		bool tooLarge = false;
+
+		// a client that stops reading the response is cut off too
+		timeval sendTimeout = {HTTP_REQUEST_TIMEOUT / 1000, (HTTP_REQUEST_TIMEOUT % 1000) * 1000};
+		setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &sendTimeout, sizeof(sendTimeout));
+
+#ifdef SO_NOSIGPIPE
+		int yes = 1;
+		setsockopt(fd, SOL_SOCKET, SO_NOSIGPIPE, &yes, sizeof(yes));
+#endif
+
+		// the whole request, not each read, so a byte at a time does not keep it open
+		int64_t deadline = ofGetElapsedTimeMillis() + HTTP_REQUEST_TIMEOUT;
+
+		// read the headers, then as much body as Content-Length says
+		while (true) {
+
+			int64_t remaining = deadline - (int64_t)ofGetElapsedTimeMillis();
+			pollfd p = {fd, POLLIN, 0};
+
+			if (remaining <= 0 || poll(&p, 1, (int)remaining) <= 0 || !running) {
+				timedOut = true;
+				break;
+			}
+
+			ssize_t n = recv(fd, chunk, sizeof(chunk), 0);
+			if (n <= 0) {
+				break;
+			}
+			data.append(chunk, n);
+
+			// one client must not make the server hold an unbounded request
+			if (data.size() > HTTP_REQUEST_MAX) {
+				tooLarge = true;
+				break;
+			}
+
+			if (headerEnd == string::npos && (headerEnd = data.find("\r\n\r\n")) != string::npos) {
+
+				string headers = ofToLower(data.substr(0, headerEnd));
+				size_t pos = headers.find("content-length:");
+
+				if (pos != string::npos) {
+					contentLength = strtoul(headers.c_str() + pos + 15, NULL, 10);
+				}
+
+				if (contentLength > HTTP_REQUEST_MAX) {
+					tooLarge = true;
+					break;
+				}
+			}
+
+			if (headerEnd != string::npos && data.size() >= headerEnd + 4 + contentLength) {
+				break;
+			}
+		}
+
+		HttpResponse response;
+
+		if (timedOut) {
+			response.status = 408;
+		} else if (tooLarge) {
+			response.status = 413;
+		} else if (headerEnd == string::npos) {
+			response.status = 400;
+		} else if (ofToLower(data.substr(0, headerEnd)).find("\r\norigin:") != string::npos) {
+			response.status = 403;
+		} else {
+
+			HttpRequest request;
+
+			vector<string> requestLine = ofSplitString(data.substr(0, data.find("\r\n")), " ");
+
+			if (requestLine.size() >= 2) {
+				request.method = requestLine[0];
+
+				string target = requestLine[1];
+				size_t query = target.find('?');
+
+				request.path = target.substr(0, query);
+				if (query != string::npos) {
+					parseParams(target.substr(query + 1), request.params);
+				}
+			}
+
+			request.body = data.substr(headerEnd + 4);
+			parseParams(request.body, request.params);
+
+			response = handler(request);
+		}
+
+		string statusText = response.status == 200 ? "OK" :
+							response.status == 201 ? "Created" :
+							response.status == 403 ? "Forbidden" :
+							response.status == 404 ? "Not Found" :
+							response.status == 408 ? "Request Timeout" :
+							response.status == 413 ? "Payload Too Large" : "Bad Request";
+
+		string head = "HTTP/1.0 " + ofToString(response.status) + " " + statusText + "\r\n" +
+			"Content-Type: " + response.contentType + "\r\n" +
+			"Content-Length: " + ofToString(response.body.size()) + "\r\n" +
+			"Connection: close\r\n\r\n";
+
+		string out = head + response.body;
+
+		for (size_t sent = 0; sent < out.size(); ) {
+			ssize_t n = send(fd, out.data() + sent, out.size() - sent, HTTP_SEND_FLAGS);
+			if (n <= 0) {
+				break;
+			}
+			sent += n;
+		}
+	}
+
+	static void parseParams(const string &str, map<string, string> &params) {
+		for (auto& pair : ofSplitString(str, "&", true)) {
+			size_t eq = pair.find('=');
+			if (eq != string::npos) {
+				params[urlDecode(pair.substr(0, eq))] = urlDecode(pair.substr(eq + 1));
+			}
+		}
+	}
+
+	Handler			handler;
+
+	vector<int>		listeners;
+	string			unixSocketPath;
+
+	std::thread		thread;
+	atomic<bool>	running {false};
+};
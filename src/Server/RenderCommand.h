@@ -0,0 +1,184 @@
+#pragma once
+
+#include "ofMain.h"
+
+#include "RenderEngine.h"
+#include "ExportSession.h"
+
+#define RENDER_COMMAND_MEMORY	1024	// MB of frame buffers while exporting
+
+// The same settings a render server job takes
+struct RenderCommandParams {
+	string	shaderPath;
+	int		width = 512;
+	int		height = 512;
+	int		format = 0;			// index into targetFormats
+	int		frameRate = 30;
+	int		duration = 120;
+	string	codec = "mpeg4";
+	int		bitrate = 800;
+	string	output;				// next to the shader when empty
+	bool	benchmark = false;	// render and time every frame, write nothing
+	bool	checkAllocations = false;	// fail the benchmark on a build without TRACK_ALLOCATIONS
+	vector<int>	proxies;		// size divisors of extra downsampled outputs
+	string	proxyFilter = "lanczos";
+	bool	cache = false;		// reuse and keep frames in data/frame-cache
+	string	backend = "fragment";	// or "compute"
+	int		tile[2] = {16, 16};		// compute work group size
+};
+
+// App run by `--render`: renders one shader with RenderEngine and no GUI,
+// then quits. Exports go through ExportSession like the Export button, and
+// `--bench` times every frame through a frame callback instead. Progress
+// and results go to stdout, the exit code is 0 on success. Built with
+// TRACK_ALLOCATIONS, `--bench` also fails when a frame after the warm up
+// allocates, so allocation regressions can be caught without a window.
+
+class RenderCommand : public ofBaseApp {
+public:
+
+	RenderCommand(RenderCommandParams params) : params(params) {}
+
+	void setup() {
+
+		ofSetFrameRate(0);
+		ofSetVerticalSync(false);
+		ofDisableArbTex();
+		ofEnableNormalizedTexCoords();
+
+		engine.setDuration(params.duration);
+		engine.setFrameRate(params.frameRate);
+		engine.allocate(params.width, params.height, ofClamp(params.format, 0, sizeof(targetFormats) / sizeof(targetFormats[0]) - 1));
+		engine.backend = params.backend == "compute" ? RENDER_COMPUTE : RENDER_FRAGMENT;
+		engine.computeTile[0] = params.tile[0];
+		engine.computeTile[1] = params.tile[1];
+
+		if (!engine.loadShader(params.shaderPath)) {
+			cerr << params.shaderPath << ": " << engine.getErrorMessage() << endl;
+			ofExit(1);
+			return;
+		}
+
+		if (params.benchmark) {
+			ofExit(benchmark() ? 0 : 1);
+			return;
+		}
+
+		const Codec *codec = ExportSession::findCodec(params.codec);
+
+		if (codec == NULL) {
+			cerr << "unknown codec " << params.codec << endl;
+			ofExit(1);
+			return;
+		}
+
+		string output = params.output;
+		if (output.empty()) {
+			output = ofFilePath::removeExt(params.shaderPath) + "." + codec->extension;
+		}
+
+		session.setProxies(params.proxies, Downsampler::fromName(params.proxyFilter));
+		session.setFrameCache(params.cache ? &frameCache : NULL);
+
+		if (!session.begin(engine, *codec, output, params.bitrate, (size_t)RENDER_COMMAND_MEMORY * 1024 * 1024)) {
+			cerr << "failed to start the encoder" << endl;
+			ofExit(1);
+			return;
+		}
+
+		cout << "rendering " << params.shaderPath << " to " << output << endl;
+	}
+
+	void update() {
+
+		if (session.getStatus() == exporting) {
+
+			// as many frames as the queue takes, the window is never shown anyway
+			while (session.exportFrame()) {}
+
+			int frame = session.getCurrentFrame();
+			if (frame / params.frameRate != reportedSecond) {
+				reportedSecond = frame / params.frameRate;
+				cout << "frame " << frame << "/" << params.duration << endl;
+			}
+		}
+
+		if (session.update()) {
+			cout << "done, " << session.getDuplicates() << " duplicate frames, " << session.getCacheHits() << " from the frame cache" << endl;
+			ofExit(0);
+		}
+	}
+
+	void exit() {
+		session.end();
+	}
+
+private:
+
+	// false when the frames allocated once settled
+	bool benchmark() {
+
+		if (params.checkAllocations && !Allocations::isTracking()) {
+			cerr << "allocations are not tracked, build with TRACK_ALLOCATIONS defined" << endl;
+			return false;
+		}
+
+		if (Allocations::isTracking() && params.duration <= ALLOCATION_WARMUP_FRAMES) {
+			cerr << "allocations are only checked after " << ALLOCATION_WARMUP_FRAMES << " frames, render more" << endl;
+			return false;
+		}
+
+		// one frame to let the driver finish compiling
+		engine.timeRender(0);
+		Allocations::settle();
+
+		vector<float> times;
+		times.reserve(params.duration);
+
+		uint64_t start = ofGetElapsedTimeMicros();
+		uint64_t checksum = 0;
+
+		engine.renderFrames(0, params.duration, [&](const RenderedFrame &frame) {
+			uint64_t now = ofGetElapsedTimeMicros();
+			times.push_back((now - start) / 1000.0f);
+			start = now;
+			checksum = Hash::combine(checksum, Hash::frame(frame.data, frame.size));
+			Allocations::nextFrame();
+		});
+
+		float total = accumulate(times.begin(), times.end(), 0.0f);
+		sort(times.begin(), times.end());
+
+		cout << params.duration << " frames at " << params.width << "x" << params.height << " " << targetFormats[engine.getFormat()].label;
+		if (engine.getActiveBackend() == RENDER_COMPUTE) {
+			cout << ", compute in " << params.tile[0] << "x" << params.tile[1] << " tiles";
+		} else if (engine.backend == RENDER_COMPUTE) {
+			cout << ", fragment (" << engine.getComputeLog() << ")";
+		}
+		cout << endl;
+		cout << "mean " << total / times.size() << "ms, median " << times[times.size() / 2] << "ms, max " << times.back() << "ms, "
+			<< 1000.0f * times.size() / total << " fps" << endl;
+		cout << "checksum " << Hash::toHex(checksum) << endl;
+
+		if (!Allocations::isTracking()) {
+			return true;
+		}
+
+		for (auto counter : Allocations::counters()) {
+			if (counter->steady > 0) {
+				cout << counter->name << " allocated " << counter->steady << " times after the warm up" << endl;
+			}
+		}
+
+		cout << "allocations " << (Allocations::steadyAllocations() == 0 ? "ok" : "failed") << endl;
+		return Allocations::steadyAllocations() == 0;
+	}
+
+	RenderCommandParams	params;
+
+	RenderEngine		engine;
+	ExportSession		session;
+	FrameCache			frameCache;
+
+	int					reportedSecond = -1;
+};
@@ -0,0 +1,42 @@
+#pragma once
+
+#include "ofMain.h"
+
+#include "Config.h"
+#include "RenderServer.h"
+
+// App run by `--daemon`: no GUI, a hidden window only provides the GL
+// context, and jobs come in through RenderServer.
+
+class RenderDaemon : public ofBaseApp {
+public:
+	
+	RenderDaemon(int port, string socketPath, bool allowAnyOutput) : port(port), socketPath(socketPath) {
+		server.allowAnyOutput = allowAnyOutput;
+	}
+	
+	void setup() {
+		
+		ofSetFrameRate(0);
+		ofSetVerticalSync(false);
+		ofDisableArbTex();
+		ofEnableNormalizedTexCoords();
+		
+		if (!server.start(port, socketPath)) {
+			ofExit(1);
+		}
+	}
+	
+	void update() {
+		server.update();
+	}
+	
+	void exit() {
+		server.stop();
+	}
+	
+	int				port;
+	string			socketPath;
+	
+	RenderServer	server;
+};
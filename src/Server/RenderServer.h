@@ -0,0 +1,417 @@
+#pragma once
+
+#include <mutex>
+#include "ofMain.h"
+
+#include "RenderEngine.h"
+#include "ExportSession.h"
+#include "HttpServer.h"
+
+#define RENDER_JOBS_DIR		ofToDataPath("jobs")
+
+enum RenderJobState {
+	JOB_QUEUED,
+	JOB_RUNNING,
+	JOB_SAVING,
+	JOB_DONE,
+	JOB_FAILED,
+	JOB_CANCELLED
+};
+
+static const char* renderJobStateNames[] = {"queued", "running", "saving", "done", "failed", "cancelled"};
+
+// The same fields the app keeps in settings.xml for the renderer and export
+struct RenderJobParams {
+	string	shaderPath;
+	int		width = 512;
+	int		height = 512;
+	int		frameRate = 30;
+	int		duration = 120;
+	string	codec = "mpeg4";
+	int		bitrate = 800;
+	string	output;
+	string	proxies;		// size divisors, "2,4" for a half and a quarter size proxy
+	string	proxyFilter = "lanczos";
+	int		priority = 0;	// higher runs first
+};
+
+struct RenderJob {
+	int					id;
+	RenderJobParams		params;
+	string				error;		// guarded by the server's mutex
+
+	// read by the HTTP thread while the main thread renders
+	atomic<RenderJobState>	state {JOB_QUEUED};
+	atomic<bool>		cancelRequested {false};
+	atomic<int>			currentFrame {0};
+	atomic<int>			framesRendered {0};
+	atomic<float>		renderTime {0};		// seconds spent rendering this job on the GPU thread
+	atomic<int>			duplicates {0};
+
+	bool				started = false;
+
+	// only while the job runs or its encoder flushes, a finished job keeps
+	// nothing but what the HTTP side reports
+	unique_ptr<RenderEngine>	renderer;
+	unique_ptr<ExportSession>	session;
+};
+
+// Job queue and scheduler for daemon mode. Jobs are submitted over HTTP from
+// any thread, but everything touching GL runs in update() on the main thread.
+// openFrameworks drives a single GL context, so running jobs share it and are
+// interleaved frame by frame within a per-update time budget, while each one
+// encodes in its own ffmpeg process.
+
+class RenderServer {
+public:
+
+	// concurrently running jobs, bounds the ffmpeg processes and memory
+	int		maxRunningJobs = 2;
+	// MB of frame buffers shared by the running jobs
+	int		memoryBudget = 1024;
+	// ms of rendering per update, so the HTTP side and the OS stay responsive
+	float	frameBudget = 50.0f;
+	// outputs anywhere the daemon can write, otherwise only in RENDER_JOBS_DIR
+	bool	allowAnyOutput = false;
+
+	bool start(int port, string socketPath) {
+
+		ofDirectory::createDirectory(RENDER_JOBS_DIR, false, true);
+
+		return http.start(port, socketPath, [this](const HttpRequest &request) {
+			return handle(request);
+		});
+	}
+
+	void stop() {
+
+		http.stop();
+
+		lock_guard<mutex> lock(mtx);
+		for (auto& job : jobs) {
+			if (job->session) {
+				job->session->end();
+			}
+		}
+	}
+
+	int submit(RenderJobParams params, string *error) {
+
+		if (params.shaderPath.empty() || !ofFile::doesFileExist(params.shaderPath, false)) {
+			*error = "shader not found";
+			return -1;
+		}
+
+		const Codec *codec = ExportSession::findCodec(params.codec);
+
+		if (codec == NULL) {
+			*error = "unknown codec";
+			return -1;
+		}
+
+		if (params.width < 4 || params.height < 4 || params.frameRate < 1 || params.duration < 1) {
+			*error = "invalid size, frame rate or duration";
+			return -1;
+		}
+
+		if (!params.output.empty() && !allowAnyOutput) {
+			if (!isJobsPath(params.output)) {
+				*error = "output has to be a relative path in the jobs folder";
+				return -1;
+			}
+			params.output = ofFilePath::join(RENDER_JOBS_DIR, params.output);
+		}
+
+		lock_guard<mutex> lock(mtx);
+
+		auto job = make_shared<RenderJob>();
+		job->id = nextId++;
+		job->params = params;
+
+		if (job->params.output.empty()) {
+			job->params.output = ofFilePath::join(RENDER_JOBS_DIR, "job_" + ofToString(job->id) + "." + codec->extension);
+		}
+
+		jobs.push_back(job);
+
+		ofLogNotice("RenderServer") << "Job " << job->id << " queued: " << params.shaderPath;
+
+		return job->id;
+	}
+
+	// main thread
+	void update() {
+
+		vector<shared_ptr<RenderJob>> running;
+
+		{
+			lock_guard<mutex> lock(mtx);
+
+			// cancelled jobs stay until their encoder has flushed
+			for (auto& job : jobs) {
+				if (job->state == JOB_RUNNING || job->state == JOB_SAVING || job->session) {
+					running.push_back(job);
+				}
+			}
+
+			// highest priority first, then in the order they came in
+			while (running.size() < maxRunningJobs) {
+
+				shared_ptr<RenderJob> next;
+
+				for (auto& job : jobs) {
+					if (job->state == JOB_QUEUED && !job->cancelRequested && (!next || job->params.priority > next->params.priority)) {
+						next = job;
+					}
+				}
+
+				if (!next) {
+					break;
+				}
+
+				next->state = JOB_RUNNING;
+				running.push_back(next);
+			}
+		}
+
+		for (auto& job : running) {
+			if (!job->started) {
+				startJob(*job);
+			}
+		}
+
+		// round robin over the running jobs until the budget is spent
+		uint64_t start = ofGetElapsedTimeMicros();
+		bool progressed = true;
+
+		while (progressed && (ofGetElapsedTimeMicros() - start) / 1000.0f < frameBudget) {
+
+			progressed = false;
+
+			for (auto& job : running) {
+
+				if (job->state != JOB_RUNNING) {
+					continue;
+				}
+
+				if (job->cancelRequested) {
+					job->session->end();
+					job->state = JOB_CANCELLED;
+					continue;
+				}
+
+				uint64_t t = ofGetElapsedTimeMicros();
+
+				if (job->session->exportFrame()) {
+					job->framesRendered++;
+					job->currentFrame = job->session->getCurrentFrame();
+					job->duplicates = job->session->getDuplicates();
+					progressed = true;
+				}
+
+				job->renderTime = job->renderTime + (ofGetElapsedTimeMicros() - t) / 1000000.0f;
+
+				if (job->session->getStatus() == saving) {
+					job->state = JOB_SAVING;
+				}
+			}
+		}
+
+		for (auto& job : running) {
+			if (job->state == JOB_FAILED) {
+				release(*job);
+			} else if (job->session && job->session->update()) {
+				if (job->state != JOB_CANCELLED) {
+					job->state = JOB_DONE;
+					ofLogNotice("RenderServer") << "Job " << job->id << " done: " << job->params.output;
+				}
+				release(*job);
+			}
+		}
+	}
+
+	HttpResponse handle(const HttpRequest &request) {
+
+		HttpResponse response;
+
+		vector<string> path = ofSplitString(request.path, "/", true);
+
+		if (path.size() == 1 && path[0] == "jobs" && request.method == "POST") {
+
+			string error;
+			int id = submit(parseParams(request.params), &error);
+
+			if (id < 0) {
+				response.status = 400;
+				response.body = "{\"error\":\"" + HttpServer::jsonEscape(error) + "\"}";
+			} else {
+				response.status = 201;
+				response.body = "{\"id\":" + ofToString(id) + "}";
+			}
+
+		} else if (path.size() == 1 && path[0] == "jobs" && request.method == "GET") {
+
+			lock_guard<mutex> lock(mtx);
+
+			response.body = "[";
+			for (int i = 0; i < jobs.size(); i++) {
+				response.body += (i > 0 ? "," : "") + toJson(*jobs[i]);
+			}
+			response.body += "]";
+
+		} else if (path.size() == 2 && path[0] == "jobs") {
+
+			lock_guard<mutex> lock(mtx);
+
+			int id = ofToInt(path[1]);
+			auto it = find_if(jobs.begin(), jobs.end(), [id](const shared_ptr<RenderJob> &job) { return job->id == id; });
+
+			if (it == jobs.end()) {
+				response.status = 404;
+				response.body = "{\"error\":\"no such job\"}";
+			} else {
+				if (request.method == "DELETE") {
+					(*it)->cancelRequested = true;
+					if ((*it)->state == JOB_QUEUED) {
+						(*it)->state = JOB_CANCELLED;
+					}
+				}
+				response.body = toJson(**it);
+			}
+
+		} else {
+			response.status = 404;
+			response.body = "{\"error\":\"not found\"}";
+		}
+
+		return response;
+	}
+
+private:
+
+	void startJob(RenderJob &job) {
+
+		RenderJobParams &p = job.params;
+
+		job.started = true;
+		job.renderer.reset(new RenderEngine());
+		job.session.reset(new ExportSession());
+
+		job.renderer->setDuration(p.duration);
+		job.renderer->setFrameRate(p.frameRate);
+		job.renderer->setSize(p.width, p.height);
+		job.renderer->loadShader(p.shaderPath);
+
+		if (!job.renderer->isCompiled()) {
+			fail(job, job.renderer->getErrorMessage());
+			return;
+		}
+
+		size_t budget = (size_t)memoryBudget * 1024 * 1024 / max(1, maxRunningJobs);
+
+		vector<int> divisors;
+		for (auto& divisor : ofSplitString(p.proxies, ",", true, true)) {
+			divisors.push_back(ofToInt(divisor));
+		}
+		job.session->setProxies(divisors, Downsampler::fromName(p.proxyFilter));
+
+		if (!job.session->begin(*job.renderer, *ExportSession::findCodec(p.codec), p.output, p.bitrate, budget)) {
+			fail(job, "failed to start the encoder");
+			return;
+		}
+
+		job.currentFrame = job.session->getCurrentFrame();
+		ofLogNotice("RenderServer") << "Job " << job.id << " started at frame " << job.currentFrame;
+	}
+
+	// relative and never stepping out with "..", anyone who can reach the
+	// port could otherwise overwrite any file the daemon can write
+	static bool isJobsPath(const string &path) {
+
+		if (ofFilePath::isAbsolute(path) || path[0] == '~') {
+			return false;
+		}
+
+		for (auto& part : ofSplitString(path, "/")) {
+			if (part == "..") {
+				return false;
+			}
+		}
+		return true;
+	}
+
+	// the error is read by the HTTP thread
+	void fail(RenderJob &job, const string &error) {
+
+		ofLogError("RenderServer") << "Job " << job.id << " failed: " << error;
+
+		lock_guard<mutex> lock(mtx);
+		job.error = error;
+		job.state = JOB_FAILED;
+	}
+
+	// the session first, it renders through the engine
+	void release(RenderJob &job) {
+		job.session.reset();
+		job.renderer.reset();
+	}
+
+	RenderJobParams parseParams(const map<string, string> &params) {
+
+		RenderJobParams p;
+
+		auto get = [&](const string &key, const string &fallback) {
+			auto it = params.find(key);
+			return it != params.end() ? it->second : fallback;
+		};
+
+		p.shaderPath	= get("shader", "");
+		p.width			= ofToInt(get("width", ofToString(p.width)));
+		p.height		= ofToInt(get("height", ofToString(p.height)));
+		p.frameRate		= ofToInt(get("frameRate", ofToString(p.frameRate)));
+		p.duration		= ofToInt(get("duration", ofToString(p.duration)));
+		p.codec			= get("codec", p.codec);
+		p.bitrate		= ofToInt(get("bitrate", ofToString(p.bitrate)));
+		p.output		= get("output", "");
+		p.proxies		= get("proxies", "");
+		p.proxyFilter	= get("proxyFilter", p.proxyFilter);
+		p.priority		= ofToInt(get("priority", "0"));
+
+		// inline source is stored with the job outputs
+		string source = get("source", "");
+
+		if (!source.empty()) {
+			ofBuffer buffer(source.data(), source.size());
+			p.shaderPath = ofFilePath::join(RENDER_JOBS_DIR, "source_" + ofGetTimestampString("%Y%m%d%H%M%S%i") + ".frag");
+			ofBufferToFile(p.shaderPath, buffer);
+		}
+
+		return p;
+	}
+
+	string toJson(const RenderJob &job) {
+
+		float elapsed = job.renderTime;
+		float throughput = elapsed > 0 ? job.framesRendered / elapsed : 0;
+		int frame = job.currentFrame;
+
+		return "{\"id\":" + ofToString(job.id) +
+			",\"state\":\"" + renderJobStateNames[job.state.load()] + "\"" +
+			",\"priority\":" + ofToString(job.params.priority) +
+			",\"shader\":\"" + HttpServer::jsonEscape(job.params.shaderPath) + "\"" +
+			",\"output\":\"" + HttpServer::jsonEscape(job.params.output) + "\"" +
+			",\"frame\":" + ofToString(frame) +
+			",\"duration\":" + ofToString(job.params.duration) +
+			",\"progress\":" + ofToString(frame / (float)job.params.duration, 3) +
+			",\"fps\":" + ofToString(throughput, 1) +
+			",\"duplicates\":" + ofToString(job.duplicates.load()) +
+			(job.state != JOB_FAILED ? "" : ",\"error\":\"" + HttpServer::jsonEscape(job.error) + "\"") +
+			"}";
+	}
+
+	HttpServer						http;
+
+	vector<shared_ptr<RenderJob>>	jobs;
+	int								nextId = 1;
+	mutex							mtx;
+};
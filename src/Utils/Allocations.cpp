@@ -0,0 +1,50 @@
+#include "Config.h"
+
+#ifdef TRACK_ALLOCATIONS
+
+#include <cstdlib>
+#include <new>
+
+#include "Allocations.h"
+
+// counts on the allocating thread and leaves the work to malloc
+
+void* operator new(std::size_t size) {
+	Allocations::threadCount()++;
+	void *ptr = malloc(size > 0 ? size : 1);
+	if (ptr == NULL) {
+		throw std::bad_alloc();
+	}
+	return ptr;
+}
+
+void* operator new[](std::size_t size) {
+	return operator new(size);
+}
+
+void* operator new(std::size_t size, const std::nothrow_t&) noexcept {
+	Allocations::threadCount()++;
+	return malloc(size > 0 ? size : 1);
+}
+
+void* operator new[](std::size_t size, const std::nothrow_t&) noexcept {
+	return operator new(size, std::nothrow);
+}
+
+void operator delete(void *ptr) noexcept {
+	free(ptr);
+}
+
+void operator delete[](void *ptr) noexcept {
+	free(ptr);
+}
+
+void operator delete(void *ptr, const std::nothrow_t&) noexcept {
+	free(ptr);
+}
+
+void operator delete[](void *ptr, const std::nothrow_t&) noexcept {
+	free(ptr);
+}
+
+#endif
@@ -0,0 +1,108 @@
+#pragma once
+
+#include "ofMain.h"
+
+#include "Config.h"
+
+#define ALLOCATION_WARMUP_FRAMES	60		// frames after settle() before allocating is reported
+
+#ifdef TRACK_ALLOCATIONS
+#define ALLOCATION_CONCAT_(a, b)	a##b
+#define ALLOCATION_CONCAT(a, b)		ALLOCATION_CONCAT_(a, b)
+// Counts the heap allocations of the enclosing scope on every call
+#define ALLOCATION_SCOPE(name)		static Allocations::Counter ALLOCATION_CONCAT(allocationCounter, __LINE__)(name); \
+									Allocations::Scope ALLOCATION_CONCAT(allocationScope, __LINE__)(ALLOCATION_CONCAT(allocationCounter, __LINE__))
+#else
+#define ALLOCATION_SCOPE(name)
+#endif
+
+// Heap allocation counting for the frame path. Built with TRACK_ALLOCATIONS
+// (Config.h), Allocations.cpp replaces the global operator new and every
+// scope marked with ALLOCATION_SCOPE counts what it allocated on its last
+// call. Once the app has settled, a scope that still allocates is logged as
+// an error, once per scope until the next settle(), and counted in `steady`
+// so `--render --bench` can fail on it. Without the flag the scopes compile
+// to nothing.
+
+namespace Allocations {
+
+	// operator new calls on this thread, kept up by Allocations.cpp
+	inline uint64_t& threadCount() {
+		static thread_local uint64_t count = 0;
+		return count;
+	}
+
+	struct Counter;
+
+	inline vector<Counter*>& counters() {
+		static vector<Counter*> list;
+		return list;
+	}
+
+	// frames since the last expected allocation, like a shader reload
+	inline int& settledFrames() {
+		static int frames = 0;
+		return frames;
+	}
+
+	inline void settle()	{ settledFrames() = 0; }
+	inline void nextFrame()	{ settledFrames()++; }
+	inline bool isSettled()	{ return settledFrames() > ALLOCATION_WARMUP_FRAMES; }
+
+	struct Counter {
+
+		Counter(const char *name) : name(name) {
+			counters().push_back(this);
+		}
+
+		void add(uint64_t count) {
+			last = count;
+			total += count;
+			calls++;
+
+			if (count > 0 && isSettled()) {
+				steady += count;
+				if (!reported) {
+					ofLogError("Allocations") << name << " allocated " << count << " times in a steady frame";
+					reported = true;
+				}
+			} else if (!isSettled()) {
+				reported = false;
+			}
+		}
+
+		const char	*name;
+		uint64_t	last = 0;
+		uint64_t	total = 0;
+		uint64_t	calls = 0;
+		uint64_t	steady = 0;		// allocations made while settled
+		bool		reported = false;
+	};
+
+	// what every scope allocated while settled, since the start
+	inline uint64_t steadyAllocations() {
+		uint64_t count = 0;
+		for (auto counter : counters()) {
+			count += counter->steady;
+		}
+		return count;
+	}
+
+	class Scope {
+	public:
+		Scope(Counter &counter) : counter(counter), start(threadCount()) {}
+		~Scope() { counter.add(threadCount() - start); }
+
+	private:
+		Counter		&counter;
+		uint64_t	start;
+	};
+
+	inline bool isTracking() {
+#ifdef TRACK_ALLOCATIONS
+		return true;
+#else
+		return false;
+#endif
+	}
+}
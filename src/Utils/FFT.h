@@ -0,0 +1,144 @@
+#pragma once
+
+#include <cmath>
+#include <cstddef>
+#include <vector>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define FFT_SSE
+#endif
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define FFT_NEON
+#endif
+
+// Radix-2 FFT on split real/imaginary arrays, for offline analysis. Twiddles
+// are laid out per stage so the butterflies of a block read them in order,
+// which lets every stage from the third on run 4 lanes at a time.
+
+class FFT {
+public:
+
+	// n is a power of two
+	void setup(size_t size) {
+
+		n = size;
+
+		bitReverse.resize(n);
+		int bits = 0;
+		while ((1u << bits) < n) bits++;
+
+		for (size_t i = 0; i < n; i++) {
+			size_t r = 0;
+			for (int b = 0; b < bits; b++) {
+				r |= ((i >> b) & 1) << (bits - 1 - b);
+			}
+			bitReverse[i] = r;
+		}
+
+		// stage with half size h uses twiddleRe[h - 1 .. 2h - 2]
+		twiddleRe.resize(n);
+		twiddleIm.resize(n);
+
+		for (size_t half = 1; half < n; half *= 2) {
+			for (size_t j = 0; j < half; j++) {
+				double angle = -M_PI * j / half;
+				twiddleRe[half - 1 + j] = cos(angle);
+				twiddleIm[half - 1 + j] = sin(angle);
+			}
+		}
+
+		re.resize(n);
+		im.resize(n);
+		window.resize(n);
+
+		// Hann
+		for (size_t i = 0; i < n; i++) {
+			window[i] = 0.5f - 0.5f * cos(2.0 * M_PI * i / (n - 1));
+		}
+	}
+
+	// Magnitudes of the first n / 2 bins of the windowed real signal,
+	// normalized so a full scale sine peaks near 1.
+	void magnitudes(const float *signal, float *out) {
+
+		for (size_t i = 0; i < n; i++) {
+			size_t r = bitReverse[i];
+			re[r] = signal[i] * window[i];
+			im[r] = 0;
+		}
+
+		transform();
+
+		float scale = 4.0f / n;
+
+		for (size_t i = 0; i < n / 2; i++) {
+			out[i] = sqrtf(re[i] * re[i] + im[i] * im[i]) * scale;
+		}
+	}
+
+	size_t size() { return n; }
+
+private:
+
+	void transform() {
+
+		float *xr = re.data(), *xi = im.data();
+
+		for (size_t half = 1; half < n; half *= 2) {
+
+			const float *wr = twiddleRe.data() + half - 1;
+			const float *wi = twiddleIm.data() + half - 1;
+
+			for (size_t k = 0; k < n; k += half * 2) {
+
+				float *ar = xr + k, *ai = xi + k;
+				float *br = ar + half, *bi = ai + half;
+
+				size_t j = 0;
+
+#if defined(FFT_SSE)
+				for (; j + 4 <= half; j += 4) {
+					__m128 twr = _mm_loadu_ps(wr + j), twi = _mm_loadu_ps(wi + j);
+					__m128 vbr = _mm_loadu_ps(br + j), vbi = _mm_loadu_ps(bi + j);
+					__m128 tr = _mm_sub_ps(_mm_mul_ps(twr, vbr), _mm_mul_ps(twi, vbi));
+					__m128 ti = _mm_add_ps(_mm_mul_ps(twr, vbi), _mm_mul_ps(twi, vbr));
+					__m128 var = _mm_loadu_ps(ar + j), vai = _mm_loadu_ps(ai + j);
+					_mm_storeu_ps(br + j, _mm_sub_ps(var, tr));
+					_mm_storeu_ps(bi + j, _mm_sub_ps(vai, ti));
+					_mm_storeu_ps(ar + j, _mm_add_ps(var, tr));
+					_mm_storeu_ps(ai + j, _mm_add_ps(vai, ti));
+				}
+#elif defined(FFT_NEON)
+				for (; j + 4 <= half; j += 4) {
+					float32x4_t twr = vld1q_f32(wr + j), twi = vld1q_f32(wi + j);
+					float32x4_t vbr = vld1q_f32(br + j), vbi = vld1q_f32(bi + j);
+					float32x4_t tr = vmlsq_f32(vmulq_f32(twr, vbr), twi, vbi);
+					float32x4_t ti = vmlaq_f32(vmulq_f32(twr, vbi), twi, vbr);
+					float32x4_t var = vld1q_f32(ar + j), vai = vld1q_f32(ai + j);
+					vst1q_f32(br + j, vsubq_f32(var, tr));
+					vst1q_f32(bi + j, vsubq_f32(vai, ti));
+					vst1q_f32(ar + j, vaddq_f32(var, tr));
+					vst1q_f32(ai + j, vaddq_f32(vai, ti));
+				}
+#endif
+				for (; j < half; j++) {
+					float tr = wr[j] * br[j] - wi[j] * bi[j];
+					float ti = wr[j] * bi[j] + wi[j] * br[j];
+					br[j] = ar[j] - tr;
+					bi[j] = ai[j] - ti;
+					ar[j] += tr;
+					ai[j] += ti;
+				}
+			}
+		}
+	}
+
+	size_t				n = 0;
+	std::vector<size_t>	bitReverse;
+	std::vector<float>	twiddleRe, twiddleIm;
+	std::vector<float>	re, im;
+	std::vector<float>	window;
+};
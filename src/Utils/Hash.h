@@ -0,0 +1,67 @@
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+// 64bit FNV-1a. Used as a content key for on-disk caches, not for security.
+
+namespace Hash {
+
+	static const uint64_t FNV_OFFSET	= 14695981039346656037ULL;
+	static const uint64_t FNV_PRIME		= 1099511628211ULL;
+
+	inline uint64_t fnv1a(const void *data, size_t length, uint64_t seed = FNV_OFFSET) {
+		const unsigned char *p = (const unsigned char *)data;
+		uint64_t h = seed;
+		for (size_t i = 0; i < length; i++) {
+			h ^= p[i];
+			h *= FNV_PRIME;
+		}
+		return h;
+	}
+
+	inline uint64_t fnv1a(const std::string &str, uint64_t seed = FNV_OFFSET) {
+		return fnv1a(str.data(), str.size(), seed);
+	}
+
+	// 8 bytes per step with four independent lanes, for comparing whole
+	// frames where byte-wise FNV would cost more than the render
+	inline uint64_t frame(const void *data, size_t length) {
+
+		static const uint64_t K = 0x9e3779b97f4a7c15ULL;
+
+		const unsigned char *p = (const unsigned char *)data;
+		uint64_t lanes[4] = {FNV_OFFSET, FNV_OFFSET ^ K, FNV_OFFSET + K, FNV_OFFSET - K};
+		size_t i = 0;
+
+		for (; i + 32 <= length; i += 32) {
+			for (int l = 0; l < 4; l++) {
+				uint64_t v;
+				memcpy(&v, p + i + l * 8, 8);
+				lanes[l] = (lanes[l] ^ v) * K;
+				lanes[l] ^= lanes[l] >> 29;
+			}
+		}
+
+		uint64_t h = fnv1a(p + i, length - i, lanes[0] ^ (lanes[1] * 3) ^ (lanes[2] * 5) ^ (lanes[3] * 7));
+		return h ^ (uint64_t)length;
+	}
+
+	template<typename T>
+	inline uint64_t combine(uint64_t seed, const T &value) {
+		return fnv1a(&value, sizeof(T), seed);
+	}
+
+	inline std::string toHex(uint64_t h) {
+		char buf[17];
+		snprintf(buf, sizeof(buf), "%016llx", (unsigned long long)h);
+		return std::string(buf);
+	}
+
+	inline uint64_t fromHex(const std::string &str) {
+		return strtoull(str.c_str(), NULL, 16);
+	}
+}
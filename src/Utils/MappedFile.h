@@ -0,0 +1,112 @@
+#pragma once
+
+#include <algorithm>
+#include <string>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+// Read only memory map of a whole file. Pages are loaded by the OS as they
+// are touched, so large caches cost nothing until they are read.
+
+class MappedFile {
+public:
+
+	~MappedFile() {
+		close();
+	}
+
+	bool open(const std::string &path) {
+
+		close();
+
+#ifdef _WIN32
+		file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+		if (file == INVALID_HANDLE_VALUE) {
+			return false;
+		}
+
+		LARGE_INTEGER fileSize;
+		GetFileSizeEx(file, &fileSize);
+		length = fileSize.QuadPart;
+
+		mapping = length > 0 ? CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL) : NULL;
+		data = mapping != NULL ? (const char*)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0) : NULL;
+#else
+		int fd = ::open(path.c_str(), O_RDONLY);
+		if (fd < 0) {
+			return false;
+		}
+
+		struct stat st;
+		if (fstat(fd, &st) == 0 && st.st_size > 0) {
+			length = st.st_size;
+			void *p = mmap(NULL, length, PROT_READ, MAP_SHARED, fd, 0);
+			data = p != MAP_FAILED ? (const char*)p : NULL;
+		}
+
+		// the mapping stays valid without the descriptor
+		::close(fd);
+#endif
+
+		if (data == NULL) {
+			close();
+			return false;
+		}
+		return true;
+	}
+
+	void close() {
+
+#ifdef _WIN32
+		if (data != NULL)						UnmapViewOfFile(data);
+		if (mapping != NULL)					CloseHandle(mapping);
+		if (file != INVALID_HANDLE_VALUE)		CloseHandle(file);
+		mapping = NULL;
+		file = INVALID_HANDLE_VALUE;
+#else
+		if (data != NULL) {
+			munmap((void*)data, length);
+		}
+#endif
+
+		data = NULL;
+		length = 0;
+	}
+
+	// Asks the OS to start reading a range in, so touching it later does not
+	// wait on the disk. Only a hint, and a no-op on Windows.
+	void prefetch(size_t offset, size_t count) const {
+#ifndef _WIN32
+		if (data == NULL || offset >= length) {
+			return;
+		}
+
+		size_t page = sysconf(_SC_PAGESIZE);
+		size_t start = offset / page * page;
+		size_t end = std::min(offset + count, length);
+
+		madvise((void*)(data + start), end - start, MADV_WILLNEED);
+#endif
+	}
+
+	const char* getData() const	{ return data; }
+	size_t size() const			{ return length; }
+	bool isOpen() const			{ return data != NULL; }
+
+private:
+
+	const char	*data = NULL;
+	size_t		length = 0;
+
+#ifdef _WIN32
+	HANDLE		file = INVALID_HANDLE_VALUE;
+	HANDLE		mapping = NULL;
+#endif
+};
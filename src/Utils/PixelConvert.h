@@ -0,0 +1,458 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <cstddef>
+
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+#define PIXEL_CONVERT_X86
+// with GCC and Clang these declare every instruction set, not only the ones
+// the translation unit is compiled for, so kernels can opt in one by one
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif
+#endif
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define PIXEL_CONVERT_SSE2
+#endif
+
+#if defined(PIXEL_CONVERT_X86) && (defined(__GNUC__) || defined(_MSC_VER))
+#define PIXEL_CONVERT_DISPATCH
+#endif
+
+#ifdef __GNUC__
+#define PIXEL_CONVERT_TARGET(isa) __attribute__((target(isa)))
+#else
+#define PIXEL_CONVERT_TARGET(isa)
+#endif
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define PIXEL_CONVERT_NEON
+#endif
+
+// CPU side conversion of float pixels read back from RGBA16F/RGBA32F targets
+// into the formats written to disk. Every kernel has a scalar fallback. On
+// x86 the SSE2 kernels are the baseline, and the SSSE3, SSE4.1, F16C and
+// AVX2 ones are compiled for their own instruction set and only called when
+// cpuid reports it, so the binary does not need to be built for a newer CPU
+// to use them. Counts are in scalars (pixels * channels), not in pixels.
+
+namespace PixelConvert {
+
+	struct CPUFeatures {
+		bool	ssse3 = false;
+		bool	sse41 = false;
+		bool	f16c = false;	// with AVX
+		bool	avx2 = false;
+	};
+
+	inline CPUFeatures detectCPUFeatures() {
+
+		CPUFeatures features;
+
+#ifdef PIXEL_CONVERT_DISPATCH
+		unsigned int regs[4] = {0, 0, 0, 0};	// eax, ebx, ecx, edx
+
+#ifdef _MSC_VER
+		int info[4];
+		__cpuid(info, 0);
+		unsigned int maxLeaf = info[0];
+		__cpuid(info, 1);
+		memcpy(regs, info, sizeof(regs));
+#else
+		unsigned int maxLeaf = __get_cpuid_max(0, NULL);
+		__get_cpuid(1, &regs[0], &regs[1], &regs[2], &regs[3]);
+#endif
+
+		features.ssse3 = (regs[2] & (1 << 9)) != 0;
+		features.sse41 = (regs[2] & (1 << 19)) != 0;
+
+		// AVX registers also need to be saved by the OS
+		bool osxsave = (regs[2] & (1 << 27)) != 0;
+		bool avx = (regs[2] & (1 << 28)) != 0;
+		bool f16c = (regs[2] & (1 << 29)) != 0;
+		bool ymm = false;
+
+		if (osxsave) {
+#ifdef _MSC_VER
+			ymm = (_xgetbv(0) & 6) == 6;
+#else
+			unsigned int eax, edx;
+			__asm__ ("xgetbv" : "=a"(eax), "=d"(edx) : "c"(0));
+			ymm = (eax & 6) == 6;
+#endif
+		}
+
+		features.f16c = avx && f16c && ymm;
+
+		if (maxLeaf >= 7 && ymm) {
+#ifdef _MSC_VER
+			__cpuidex(info, 7, 0);
+			features.avx2 = (info[1] & (1 << 5)) != 0;
+#else
+			__cpuid_count(7, 0, regs[0], regs[1], regs[2], regs[3]);
+			features.avx2 = (regs[1] & (1 << 5)) != 0;
+#endif
+		}
+#endif
+
+		return features;
+	}
+
+	inline const CPUFeatures& getCPUFeatures() {
+		static const CPUFeatures features = detectCPUFeatures();
+		return features;
+	}
+
+	// round to nearest even, overflow to inf, keeps NaN
+	inline uint16_t floatToHalf(float value) {
+
+		uint32_t x;
+		memcpy(&x, &value, 4);
+
+		uint32_t sign = (x >> 16) & 0x8000;
+		uint32_t a = x & 0x7fffffff;
+
+		if (a >= 0x47800000) {
+			return sign | (a > 0x7f800000 ? 0x7e00 : 0x7c00);
+		}
+
+		if (a < 0x38800000) {
+			// denormal, let the FPU do the rounding
+			float f;
+			memcpy(&f, &a, 4);
+			f += 0.5f;
+			uint32_t r;
+			memcpy(&r, &f, 4);
+			return sign | (uint16_t)(r - 0x3f000000);
+		}
+
+		uint32_t mantOdd = (a >> 13) & 1;
+		a += 0xc8000fff + mantOdd;
+
+		return sign | (uint16_t)(a >> 13);
+	}
+
+	// Each kernel converts a prefix of the input and returns how far it got,
+	// the scalar loops of the callers finish the rest.
+
+#ifdef PIXEL_CONVERT_DISPATCH
+	PIXEL_CONVERT_TARGET("avx,f16c")
+	inline size_t floatToHalfF16C(const float *src, uint16_t *dst, size_t count) {
+		size_t i = 0;
+		for (; i + 8 <= count; i += 8) {
+			__m128i h = _mm256_cvtps_ph(_mm256_loadu_ps(src + i), _MM_FROUND_TO_NEAREST_INT);
+			_mm_storeu_si128((__m128i*)(dst + i), h);
+		}
+		return i;
+	}
+
+	PIXEL_CONVERT_TARGET("avx2")
+	inline size_t floatToUint16AVX2(const float *src, uint16_t *dst, size_t count) {
+
+		const __m256 zero = _mm256_setzero_ps(), one = _mm256_set1_ps(1.0f);
+		const __m256 scale = _mm256_set1_ps(65535.0f), half = _mm256_set1_ps(0.5f);
+
+		size_t i = 0;
+		for (; i + 16 <= count; i += 16) {
+			__m256 a = _mm256_min_ps(_mm256_max_ps(_mm256_loadu_ps(src + i), zero), one);
+			__m256 b = _mm256_min_ps(_mm256_max_ps(_mm256_loadu_ps(src + i + 8), zero), one);
+			__m256i ia = _mm256_cvttps_epi32(_mm256_add_ps(_mm256_mul_ps(a, scale), half));
+			__m256i ib = _mm256_cvttps_epi32(_mm256_add_ps(_mm256_mul_ps(b, scale), half));
+			// packus works per 128bit lane, put the quadwords back in order
+			__m256i packed = _mm256_permute4x64_epi64(_mm256_packus_epi32(ia, ib), 0xd8);
+			_mm256_storeu_si256((__m256i*)(dst + i), packed);
+		}
+		return i;
+	}
+
+	PIXEL_CONVERT_TARGET("sse4.1")
+	inline size_t floatToUint16SSE41(const float *src, uint16_t *dst, size_t count) {
+
+		const __m128 zero = _mm_setzero_ps(), one = _mm_set1_ps(1.0f);
+		const __m128 scale = _mm_set1_ps(65535.0f), half = _mm_set1_ps(0.5f);
+
+		size_t i = 0;
+		for (; i + 8 <= count; i += 8) {
+			__m128 a = _mm_min_ps(_mm_max_ps(_mm_loadu_ps(src + i), zero), one);
+			__m128 b = _mm_min_ps(_mm_max_ps(_mm_loadu_ps(src + i + 4), zero), one);
+			__m128i ia = _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(a, scale), half));
+			__m128i ib = _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(b, scale), half));
+			_mm_storeu_si128((__m128i*)(dst + i), _mm_packus_epi32(ia, ib));
+		}
+		return i;
+	}
+
+	PIXEL_CONVERT_TARGET("ssse3")
+	inline size_t rgbaToRgbSSSE3(const uint8_t *src, uint8_t *dst, size_t pixels) {
+
+		const __m128i shuffle = _mm_setr_epi8(0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1);
+
+		// every 4 pixels store 16 bytes but advance 12, so stop while the overlap still fits
+		size_t i = 0;
+		for (; i + 6 <= pixels; i += 4) {
+			__m128i v = _mm_loadu_si128((const __m128i*)(src + i * 4));
+			_mm_storeu_si128((__m128i*)(dst + i * 3), _mm_shuffle_epi8(v, shuffle));
+		}
+		return i;
+	}
+
+	PIXEL_CONVERT_TARGET("ssse3")
+	inline size_t rgbaToRgbSSSE3(const uint16_t *src, uint16_t *dst, size_t pixels) {
+
+		const __m128i shuffle = _mm_setr_epi8(0, 1, 2, 3, 4, 5, 8, 9, 10, 11, 12, 13, -1, -1, -1, -1);
+
+		size_t i = 0;
+		for (; i + 3 <= pixels; i += 2) {
+			__m128i v = _mm_loadu_si128((const __m128i*)(src + i * 4));
+			_mm_storeu_si128((__m128i*)(dst + i * 3), _mm_shuffle_epi8(v, shuffle));
+		}
+		return i;
+	}
+#endif
+
+#ifdef PIXEL_CONVERT_SSE2
+	inline size_t floatToHalfSSE2(const float *src, uint16_t *dst, size_t count) {
+
+		const __m128i signMask	= _mm_set1_epi32(0x80000000);
+		const __m128i one		= _mm_set1_epi32(1);
+		const __m128i bias		= _mm_set1_epi32(0xc8000fff);
+		const __m128i denormMin	= _mm_set1_epi32(0x38800000);
+		const __m128i overflow	= _mm_set1_epi32(0x477fffff);
+		const __m128i f32Inf	= _mm_set1_epi32(0x7f800000);
+		const __m128i halfInf	= _mm_set1_epi32(0x7c00);
+		const __m128i halfNaN	= _mm_set1_epi32(0x7e00);
+		const __m128 denormMagic = _mm_set1_ps(0.5f);
+		const __m128i denormBits = _mm_set1_epi32(0x3f000000);
+
+		size_t i = 0;
+		for (; i + 8 <= count; i += 8) {
+
+			__m128i out[2];
+
+			for (int k = 0; k < 2; k++) {
+
+				__m128i x		= _mm_castps_si128(_mm_loadu_ps(src + i + k * 4));
+				__m128i sign	= _mm_and_si128(x, signMask);
+				__m128i a		= _mm_xor_si128(x, sign);
+
+				__m128i mantOdd	= _mm_and_si128(_mm_srli_epi32(a, 13), one);
+				__m128i normal	= _mm_srli_epi32(_mm_add_epi32(_mm_add_epi32(a, bias), mantOdd), 13);
+
+				__m128i denorm	= _mm_sub_epi32(_mm_castps_si128(_mm_add_ps(_mm_castsi128_ps(a), denormMagic)), denormBits);
+
+				__m128i isNaN	= _mm_cmpgt_epi32(a, f32Inf);
+				__m128i infNaN	= _mm_or_si128(_mm_and_si128(isNaN, halfNaN), _mm_andnot_si128(isNaN, halfInf));
+
+				__m128i isDenorm = _mm_cmplt_epi32(a, denormMin);
+				__m128i isBig	= _mm_cmpgt_epi32(a, overflow);
+
+				__m128i r = _mm_or_si128(_mm_and_si128(isDenorm, denorm), _mm_andnot_si128(isDenorm, normal));
+				r = _mm_or_si128(_mm_and_si128(isBig, infNaN), _mm_andnot_si128(isBig, r));
+				r = _mm_or_si128(r, _mm_srli_epi32(sign, 16));
+
+				// sign extend so that the signed saturating pack keeps all 16 bits
+				out[k] = _mm_srai_epi32(_mm_slli_epi32(r, 16), 16);
+			}
+
+			_mm_storeu_si128((__m128i*)(dst + i), _mm_packs_epi32(out[0], out[1]));
+		}
+		return i;
+	}
+
+	inline size_t floatToUint16SSE2(const float *src, uint16_t *dst, size_t count) {
+
+		const __m128 zero = _mm_setzero_ps(), one = _mm_set1_ps(1.0f);
+		const __m128 scale = _mm_set1_ps(65535.0f), half = _mm_set1_ps(0.5f);
+
+		// no unsigned pack before SSE4.1, bias into the signed range and back
+		const __m128i bias32 = _mm_set1_epi32(32768);
+		const __m128i bias16 = _mm_set1_epi16((short)0x8000);
+
+		size_t i = 0;
+		for (; i + 8 <= count; i += 8) {
+			__m128 a = _mm_min_ps(_mm_max_ps(_mm_loadu_ps(src + i), zero), one);
+			__m128 b = _mm_min_ps(_mm_max_ps(_mm_loadu_ps(src + i + 4), zero), one);
+			__m128i ia = _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(a, scale), half));
+			__m128i ib = _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(b, scale), half));
+			__m128i packed = _mm_xor_si128(_mm_packs_epi32(_mm_sub_epi32(ia, bias32), _mm_sub_epi32(ib, bias32)), bias16);
+			_mm_storeu_si128((__m128i*)(dst + i), packed);
+		}
+		return i;
+	}
+
+	inline size_t floatToUint8SSE2(const float *src, uint8_t *dst, size_t count) {
+
+		const __m128 zero = _mm_setzero_ps(), one = _mm_set1_ps(1.0f);
+		const __m128 scale = _mm_set1_ps(255.0f), half = _mm_set1_ps(0.5f);
+
+		size_t i = 0;
+		for (; i + 16 <= count; i += 16) {
+			__m128i v[4];
+			for (int k = 0; k < 4; k++) {
+				__m128 f = _mm_min_ps(_mm_max_ps(_mm_loadu_ps(src + i + k * 4), zero), one);
+				v[k] = _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(f, scale), half));
+			}
+			__m128i lo = _mm_packs_epi32(v[0], v[1]);
+			__m128i hi = _mm_packs_epi32(v[2], v[3]);
+			_mm_storeu_si128((__m128i*)(dst + i), _mm_packus_epi16(lo, hi));
+		}
+		return i;
+	}
+#endif
+
+#ifdef PIXEL_CONVERT_NEON
+	inline size_t floatToHalfNEON(const float *src, uint16_t *dst, size_t count) {
+		size_t i = 0;
+#ifdef __aarch64__
+		for (; i + 4 <= count; i += 4) {
+			float16x4_t h = vcvt_f16_f32(vld1q_f32(src + i));
+			vst1_u16(dst + i, vreinterpret_u16_f16(h));
+		}
+#endif
+		return i;
+	}
+
+	inline size_t floatToUint16NEON(const float *src, uint16_t *dst, size_t count) {
+
+		const float32x4_t zero = vdupq_n_f32(0.0f), one = vdupq_n_f32(1.0f);
+		const float32x4_t scale = vdupq_n_f32(65535.0f), half = vdupq_n_f32(0.5f);
+
+		size_t i = 0;
+		for (; i + 8 <= count; i += 8) {
+			float32x4_t a = vminq_f32(vmaxq_f32(vld1q_f32(src + i), zero), one);
+			float32x4_t b = vminq_f32(vmaxq_f32(vld1q_f32(src + i + 4), zero), one);
+			uint32x4_t ia = vcvtq_u32_f32(vmlaq_f32(half, a, scale));
+			uint32x4_t ib = vcvtq_u32_f32(vmlaq_f32(half, b, scale));
+			vst1q_u16(dst + i, vcombine_u16(vqmovn_u32(ia), vqmovn_u32(ib)));
+		}
+		return i;
+	}
+
+	inline size_t floatToUint8NEON(const float *src, uint8_t *dst, size_t count) {
+
+		const float32x4_t zero = vdupq_n_f32(0.0f), one = vdupq_n_f32(1.0f);
+		const float32x4_t scale = vdupq_n_f32(255.0f), half = vdupq_n_f32(0.5f);
+
+		size_t i = 0;
+		for (; i + 8 <= count; i += 8) {
+			float32x4_t a = vminq_f32(vmaxq_f32(vld1q_f32(src + i), zero), one);
+			float32x4_t b = vminq_f32(vmaxq_f32(vld1q_f32(src + i + 4), zero), one);
+			uint16x8_t s = vcombine_u16(vqmovn_u32(vcvtq_u32_f32(vmlaq_f32(half, a, scale))),
+										vqmovn_u32(vcvtq_u32_f32(vmlaq_f32(half, b, scale))));
+			vst1_u8(dst + i, vqmovn_u16(s));
+		}
+		return i;
+	}
+
+	inline size_t rgbaToRgbNEON(const uint8_t *src, uint8_t *dst, size_t pixels) {
+		size_t i = 0;
+		for (; i + 16 <= pixels; i += 16) {
+			uint8x16x4_t v = vld4q_u8(src + i * 4);
+			uint8x16x3_t o = {{ v.val[0], v.val[1], v.val[2] }};
+			vst3q_u8(dst + i * 3, o);
+		}
+		return i;
+	}
+
+	inline size_t rgbaToRgbNEON(const uint16_t *src, uint16_t *dst, size_t pixels) {
+		size_t i = 0;
+		for (; i + 8 <= pixels; i += 8) {
+			uint16x8x4_t v = vld4q_u16(src + i * 4);
+			uint16x8x3_t o = {{ v.val[0], v.val[1], v.val[2] }};
+			vst3q_u16(dst + i * 3, o);
+		}
+		return i;
+	}
+#endif
+
+	inline void floatToHalf(const float *src, uint16_t *dst, size_t count) {
+
+		size_t i = 0;
+
+#if defined(PIXEL_CONVERT_DISPATCH)
+		if (getCPUFeatures().f16c) {
+			i = floatToHalfF16C(src, dst, count);
+		}
+#endif
+#if defined(PIXEL_CONVERT_SSE2)
+		if (i == 0) {
+			i = floatToHalfSSE2(src, dst, count);
+		}
+#elif defined(PIXEL_CONVERT_NEON)
+		i = floatToHalfNEON(src, dst, count);
+#endif
+
+		for (; i < count; i++) {
+			dst[i] = floatToHalf(src[i]);
+		}
+	}
+
+	// clamps to [0, 1] and scales to the full 16bit range
+	inline void floatToUint16(const float *src, uint16_t *dst, size_t count) {
+
+		size_t i = 0;
+
+#if defined(PIXEL_CONVERT_DISPATCH)
+		if (getCPUFeatures().avx2) {
+			i = floatToUint16AVX2(src, dst, count);
+		} else if (getCPUFeatures().sse41) {
+			i = floatToUint16SSE41(src, dst, count);
+		}
+#endif
+#if defined(PIXEL_CONVERT_SSE2)
+		if (i == 0) {
+			i = floatToUint16SSE2(src, dst, count);
+		}
+#elif defined(PIXEL_CONVERT_NEON)
+		i = floatToUint16NEON(src, dst, count);
+#endif
+
+		for (; i < count; i++) {
+			float v = src[i] < 0.0f ? 0.0f : (src[i] > 1.0f ? 1.0f : src[i]);
+			dst[i] = (uint16_t)(v * 65535.0f + 0.5f);
+		}
+	}
+
+	inline void floatToUint8(const float *src, uint8_t *dst, size_t count) {
+
+		size_t i = 0;
+
+#if defined(PIXEL_CONVERT_SSE2)
+		i = floatToUint8SSE2(src, dst, count);
+#elif defined(PIXEL_CONVERT_NEON)
+		i = floatToUint8NEON(src, dst, count);
+#endif
+
+		for (; i < count; i++) {
+			float v = src[i] < 0.0f ? 0.0f : (src[i] > 1.0f ? 1.0f : src[i]);
+			dst[i] = (uint8_t)(v * 255.0f + 0.5f);
+		}
+	}
+
+	// drops the alpha channel, in place is allowed, T is uint8_t or uint16_t
+	template<typename T>
+	inline void rgbaToRgb(const T *src, T *dst, size_t pixels) {
+
+		size_t i = 0;
+
+#if defined(PIXEL_CONVERT_DISPATCH)
+		if (getCPUFeatures().ssse3) {
+			i = rgbaToRgbSSSE3(src, dst, pixels);
+		}
+#elif defined(PIXEL_CONVERT_NEON)
+		i = rgbaToRgbNEON(src, dst, pixels);
+#endif
+
+		for (; i < pixels; i++) {
+			dst[i * 3 + 0] = src[i * 4 + 0];
+			dst[i * 3 + 1] = src[i * 4 + 1];
+			dst[i * 3 + 2] = src[i * 4 + 2];
+		}
+	}
+}
@@ -0,0 +1,29 @@
+#pragma once
+
+#include <string>
+
+// Quoting for the commands handed to popen() and system(). Paths reach
+// them from shader annotations and from the render server's API, so
+// every one is quoted, never just wrapped in double quotes.
+
+namespace Shell {
+
+	// One argument for /bin/sh: single quotes take everything literally,
+	// a quote inside becomes '\''. cmd.exe has no single quotes, but a
+	// Windows path cannot contain a double quote.
+	inline std::string quote(const std::string &arg) {
+#ifdef _WIN32
+		return "\"" + arg + "\"";
+#else
+		std::string result = "'";
+		for (char c : arg) {
+			if (c == '\'') {
+				result += "'\\''";
+			} else {
+				result += c;
+			}
+		}
+		return result + "'";
+#endif
+	}
+}
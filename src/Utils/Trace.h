@@ -0,0 +1,177 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <fstream>
+#include <algorithm>
+
+#define TRACE_BUFFER_EVENTS		65536	// per thread, the oldest are overwritten
+
+#define TRACE_CONCAT_(a, b)		a##b
+#define TRACE_CONCAT(a, b)		TRACE_CONCAT_(a, b)
+
+// Times the enclosing scope. Costs one relaxed load while tracing is off.
+#define TRACE_SCOPE(name)		Trace::Scope TRACE_CONCAT(traceScope, __LINE__)(name)
+
+// Chrome trace recorder. Each thread appends complete events to its own
+// ring buffer, so recording takes no lock; the rings are only walked when
+// the trace is written. Open the JSON in chrome://tracing or Perfetto.
+
+namespace Trace {
+
+	struct Event {
+		const char	*name;		// string literals only, they are not copied
+		int64_t		start;		// microseconds since the first use
+		int64_t		duration;
+	};
+
+	struct Buffer {
+		Event					events[TRACE_BUFFER_EVENTS];
+		std::atomic<uint64_t>	count {0};		// written by the owning thread only
+		std::atomic<uint64_t>	from {0};		// events before this were cleared
+		std::string				threadName;
+		int						tid;
+		bool					inUse = true;
+	};
+
+	struct State {
+		std::atomic<bool>						enabled {false};
+		std::mutex								mtx;		// registration and dumping
+		std::vector<std::unique_ptr<Buffer>>	buffers;
+		std::chrono::steady_clock::time_point	origin = std::chrono::steady_clock::now();
+	};
+
+	inline State& state() {
+		static State s;
+		return s;
+	}
+
+	inline int64_t now() {
+		return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - state().origin).count();
+	}
+
+	// Buffers of exited threads are handed to new ones, so an encoder thread
+	// per export does not grow the memory. Their events stay until overwritten.
+	inline Buffer* threadBuffer() {
+
+		struct Owner {
+			Buffer *buffer = NULL;
+			~Owner() {
+				if (buffer) {
+					std::lock_guard<std::mutex> lock(state().mtx);
+					buffer->inUse = false;
+				}
+			}
+		};
+
+		thread_local Owner owner;
+
+		if (owner.buffer == NULL) {
+			State &s = state();
+			std::lock_guard<std::mutex> lock(s.mtx);
+
+			for (auto& buffer : s.buffers) {
+				if (!buffer->inUse) {
+					owner.buffer = buffer.get();
+					break;
+				}
+			}
+
+			if (owner.buffer == NULL) {
+				s.buffers.push_back(std::unique_ptr<Buffer>(new Buffer()));
+				owner.buffer = s.buffers.back().get();
+				owner.buffer->tid = s.buffers.size();
+			}
+
+			owner.buffer->inUse = true;
+			owner.buffer->threadName = "thread " + std::to_string(owner.buffer->tid);
+		}
+
+		return owner.buffer;
+	}
+
+	inline bool isEnabled() {
+		return state().enabled.load(std::memory_order_relaxed);
+	}
+
+	inline void setEnabled(bool enabled) {
+		state().enabled.store(enabled, std::memory_order_relaxed);
+	}
+
+	// shown as the track name
+	inline void setThreadName(const std::string &name) {
+		State &s = state();
+		Buffer *buffer = threadBuffer();
+		std::lock_guard<std::mutex> lock(s.mtx);
+		buffer->threadName = name;
+	}
+
+	inline void record(const char *name, int64_t start, int64_t end) {
+		Buffer *buffer = threadBuffer();
+		uint64_t i = buffer->count.load(std::memory_order_relaxed);
+		Event &e = buffer->events[i % TRACE_BUFFER_EVENTS];
+		e.name = name;
+		e.start = start;
+		e.duration = end - start;
+		buffer->count.store(i + 1, std::memory_order_release);
+	}
+
+	// forgets everything recorded so far
+	inline void clear() {
+		State &s = state();
+		std::lock_guard<std::mutex> lock(s.mtx);
+		for (auto& buffer : s.buffers) {
+			buffer->from.store(buffer->count.load(std::memory_order_acquire));
+		}
+	}
+
+	inline bool write(const std::string &path) {
+
+		State &s = state();
+		std::lock_guard<std::mutex> lock(s.mtx);
+
+		std::ofstream out(path);
+		out << "{\"traceEvents\":[\n";
+
+		bool first = true;
+
+		for (auto& buffer : s.buffers) {
+
+			out << (first ? "" : ",\n") << "{\"ph\":\"M\",\"pid\":1,\"tid\":" << buffer->tid
+				<< ",\"name\":\"thread_name\",\"args\":{\"name\":\"" << buffer->threadName << "\"}}";
+			first = false;
+
+			uint64_t count = buffer->count.load(std::memory_order_acquire);
+			uint64_t from = std::max(buffer->from.load(), count > TRACE_BUFFER_EVENTS ? count - TRACE_BUFFER_EVENTS : 0);
+
+			for (uint64_t i = from; i < count; i++) {
+				const Event &e = buffer->events[i % TRACE_BUFFER_EVENTS];
+				out << ",\n{\"ph\":\"X\",\"pid\":1,\"tid\":" << buffer->tid << ",\"name\":\"" << e.name
+					<< "\",\"ts\":" << e.start << ",\"dur\":" << e.duration << "}";
+			}
+		}
+
+		out << "\n]}\n";
+		return (bool)out;
+	}
+
+	class Scope {
+	public:
+
+		Scope(const char *name) : name(name), start(isEnabled() ? now() : -1) {}
+
+		~Scope() {
+			if (start >= 0) {
+				record(name, start, now());
+			}
+		}
+
+	private:
+		const char	*name;
+		int64_t		start;
+	};
+}
@@ -1,5 +1,7 @@
 #pragma comment(linker, "/subsystem:\"windows\" /entry:\"mainCRTStartup\"")
 
+#include <csignal>
+
 #include "ofMain.h"
 #include "ofApp.h"
 #include "ofAppGLFWWindow.h"
@@ -7,8 +9,123 @@
 #include "WindowUtils.h"
 #include "Config.h"
 
+#include "RenderCommand.h"
+#include "ShaderScanner.h"
+
+#ifndef TARGET_WIN32
+#include "RenderDaemon.h"
+#endif
+
+// windowless apps only need a GL context
+static void createHiddenWindow() {
+	ofGLFWWindowSettings settings;
+	settings.width = 64;
+	settings.height = 64;
+	settings.visible = false;
+	ofCreateWindow(settings);
+}
+
 //========================================================================
-int main( ){
+int main(int argc, char *argv[]){
+	
+	vector<string> args(argv + 1, argv + argc);
+	
+#ifndef TARGET_WIN32
+	// an ffmpeg that exited or an HTTP client that hung up shows up as a
+	// failed write, which is handled, instead of killing the process
+	signal(SIGPIPE, SIG_IGN);
+#endif
+	
+	// --render shader.frag [--size 1920x1080] [--format 0-2] [--fps 30] [--frames 120]
+	//   [--codec mpeg4] [--bitrate 800] [--output out.mov] [--proxies 2,4] [--proxy-filter lanczos] [--cache] [--bench]
+	//   [--backend fragment|compute] [--tile 16x16] [--check-allocations]
+	auto render = find(args.begin(), args.end(), "--render");
+	
+	if (render != args.end() && render + 1 != args.end()) {
+		
+		RenderCommandParams params;
+		params.shaderPath = ofFilePath::getAbsolutePath(*(render + 1), false);
+		
+		for (int i = 0; i < args.size(); i++) {
+			if (args[i] == "--bench")	params.benchmark = true;
+			if (args[i] == "--cache")	params.cache = true;
+			if (args[i] == "--check-allocations")	params.benchmark = params.checkAllocations = true;
+			if (i + 1 == args.size())	continue;
+			
+			const string &value = args[i + 1];
+			
+			if (args[i] == "--size") {
+				vector<string> size = ofSplitString(value, "x");
+				if (size.size() == 2) {
+					params.width = ofToInt(size[0]);
+					params.height = ofToInt(size[1]);
+				}
+			}
+			if (args[i] == "--format")	params.format = ofToInt(value);
+			if (args[i] == "--fps")		params.frameRate = max(1, ofToInt(value));
+			if (args[i] == "--frames")	params.duration = max(1, ofToInt(value));
+			if (args[i] == "--codec")	params.codec = value;
+			if (args[i] == "--bitrate")	params.bitrate = ofToInt(value);
+			if (args[i] == "--output")	params.output = ofFilePath::getAbsolutePath(value, false);
+			if (args[i] == "--proxy-filter")	params.proxyFilter = value;
+			if (args[i] == "--backend")	params.backend = value;
+			if (args[i] == "--tile") {
+				vector<string> tile = ofSplitString(value, "x");
+				if (tile.size() == 2) {
+					params.tile[0] = ofToInt(tile[0]);
+					params.tile[1] = ofToInt(tile[1]);
+				}
+			}
+			if (args[i] == "--proxies") {
+				for (auto& divisor : ofSplitString(value, ",", true, true)) {
+					params.proxies.push_back(ofToInt(divisor));
+				}
+			}
+		}
+		
+		createHiddenWindow();
+		// the exit code RenderCommand passed to ofExit()
+		return ofRunApp(new RenderCommand(params));
+	}
+	
+	// --bench-scan shader.frag [--iterations 100]
+	auto benchScan = find(args.begin(), args.end(), "--bench-scan");
+	
+	if (benchScan != args.end() && benchScan + 1 != args.end()) {
+		
+		int iterations = 100;
+		for (int i = 0; i + 1 < args.size(); i++) {
+			if (args[i] == "--iterations")	iterations = max(1, ofToInt(args[i + 1]));
+		}
+		
+		string source = ofBufferFromFile(ofFilePath::getAbsolutePath(*(benchScan + 1), false)).getText();
+		ShaderScanner::Benchmark result = ShaderScanner::benchmark(source, iterations);
+		
+		cout << source.size() << " bytes, " << iterations << " passes" << endl;
+		cout << "scanner " << result.scanner << "ms, " << result.scannerTextures << " textures" << endl;
+		cout << "regex   " << result.regex << "ms, " << result.regexTextures << " textures" << endl;
+		cout << result.regex / max(result.scanner, 0.001f) << "x" << endl;
+		return 0;
+	}
+	
+#ifndef TARGET_WIN32
+	// --daemon [--port 8800] [--socket /tmp/glsl-renderer.sock] [--allow-any-output]
+	if (find(args.begin(), args.end(), "--daemon") != args.end()) {
+		
+		int port = RENDER_SERVER_PORT;
+		string socketPath;
+		bool allowAnyOutput = find(args.begin(), args.end(), "--allow-any-output") != args.end();
+		
+		for (int i = 0; i + 1 < args.size(); i++) {
+			if (args[i] == "--port")	port = ofToInt(args[i + 1]);
+			if (args[i] == "--socket")	socketPath = args[i + 1];
+		}
+		
+		createHiddenWindow();
+		ofRunApp(new RenderDaemon(port, socketPath, allowAnyOutput));
+		return 0;
+	}
+#endif
 	
 	ofAppGLFWWindow win;
 	
@@ -18,14 +18,17 @@ void ofApp::setup(){
 	ofDisableArbTex();
 	ofEnableNormalizedTexCoords();
 	
+	Trace::setThreadName("main");
+	
+	logStartup("window");
+	
 	// setup imgui
-	ImOf::SetFont();
+	bool cachedFont = ImOf::SetFont();
+	logStartup(cachedFont ? "fonts (cached)" : "fonts");
+	
 	gui.setup();
 	ImOf::SetStyle();
-	
-	// set codecs
-	codecs.push_back((Codec){"PNG", "png", "mov"});
-	codecs.push_back((Codec){"MPEG4", "mpeg4", "mov"});
+	logStartup("gui");
 	
 	// setup
 	managers.push_back(&glsl);
@@ -38,52 +41,95 @@ void ofApp::setup(){
 	// event
 	ofAddListener(glsl.frameRateUpdated, this, &ofApp::frameRateUpdated);
 	ofAddListener(shaderFile.shaderFileSelected, this, &ofApp::shaderFileSelected);
-	ofAddListener(vidRecorder.outputFileCompleteEvent, this, &ofApp::recordingComplete);
 	
 	// load settings
 	ofxXmlSettings settings("settings.xml");
 	
 	selectedCodec	= settings.getValue("selectedCodec", selectedCodec);
 	bitrate			= settings.getValue("bitrate", bitrate);
+	memoryBudget	= settings.getValue("memoryBudget", memoryBudget);
+	proxies			= settings.getValue("proxies", (int)proxies);
+	proxyFilter		= settings.getValue("proxyFilter", proxyFilter);
+	useFrameCache	= settings.getValue("frameCache", useFrameCache);
+	frameCacheLimit	= settings.getValue("frameCacheLimit", frameCacheLimit);
 	exportName		= settings.getValue("exportName", "export");
+	traceExport		= settings.getValue("traceExport", traceExport);
 	
 	for (auto& manager : managers) {
 		manager->loadSettings(settings);
 	}
+	
+	logStartup("settings");
 }
 
 //--------------------------------------------------------------
 void ofApp::update(){
 	
+	TRACE_SCOPE("ofApp::update");
+	ALLOCATION_SCOPE("ofApp::update");
+	
+	Allocations::nextFrame();
+	
+	// the window has shown its first frame, now the shader and its textures
+	if (framesDrawn == 1) {
+		logStartup("first frame");
+		glsl.loadPendingShader();
+		logStartup("shader");
+		ofLogNotice("Startup") << startupLog << ", " << ofGetElapsedTimeMillis() << "ms in total";
+	}
+	
+	if (exportSession.getStatus() == stopped) {
+		estimate.update(glsl.getEngine());
+	}
+	
 	for (auto& manager : managers) {
 		manager->update();
 	}
 	
-	if (exportingStatus == exporting) {
-		
-		glsl.readToPixelsAtFrame(currentFrame, pixels);
-		vidRecorder.addFrame(pixels);
+	if (exportSession.getStatus() == exporting) {
+		exportSession.exportFrame();
 		
-		if (++currentFrame == glsl.getDuration()) {
+		if (exportSession.getStatus() != exporting) {
 			endExport();
 		}
 	}
+	
+	if (exportSession.update()) {
+		// the output has been finalized
+		glsl.resetPlay();
+		
+		if (traceExport) {
+			saveTrace(exportPath + ".trace.json");
+			Trace::setEnabled(tracing);
+		}
+	}
 }
 
 //--------------------------------------------------------------
 void ofApp::draw(){
 	
+	TRACE_SCOPE("ofApp::draw");
+	ALLOCATION_SCOPE("ofApp::draw");
+	
 	ofBackground(0);
 	
 	glsl.draw();
 	
 	drawImGui();
+	
+	if (framesDrawn < 2) {
+		framesDrawn++;
+	}
 }
 
 //--------------------------------------------------------------
 void ofApp::beginExport() {
 	
-	Codec codec = codecs[selectedCodec];
+	if (exportSession.getStatus() != stopped) {
+		return;
+	}
+	
+	const Codec &codec = ExportSession::getCodecs()[selectedCodec];
 	
 	ofFileDialogResult result = ofSystemSaveDialog(exportName + "." + codec.extension, "Save");
 	
@@ -91,42 +137,71 @@ void ofApp::beginExport() {
 		return;
 	}
 	
-	vidRecorder.setVideoCodec(codec.name);
-	vidRecorder.setVideoBitrate(ofToString(bitrate) + "k");
-		
-	int w = glsl.getWidth(), h = glsl.getHeight();
-	int frameRate = glsl.getFrameRate();
+	vector<int> divisors;
+	for (int i = 0; i < 3; i++) {
+		if (proxies & (1 << i)) {
+			divisors.push_back(2 << i);
+		}
+	}
+	exportSession.setProxies(divisors, (DownsampleFilter)proxyFilter);
 	
-	currentFrame = 0;
-	pixels.allocate(w, h, GL_RGB);
+	frameCache.setLimit((size_t)frameCacheLimit * 1024 * 1024);
+	exportSession.setFrameCache(useFrameCache ? &frameCache : NULL);
 	
-	vidRecorder.setup(result.getPath(), w, h, frameRate);
-	vidRecorder.start();
+	if (!exportSession.begin(glsl.getEngine(), codec, result.getPath(), bitrate, (size_t)memoryBudget * 1024 * 1024)) {
+		return;
+	}
+	
+	exportPath = result.getPath();
+	Allocations::settle();
+	
+	if (traceExport) {
+		// only this export in the trace
+		Trace::clear();
+		Trace::setEnabled(true);
+	}
 	
-	glsl.setRecording(true);
-	exportingStatus = exporting;
-	ofSetFrameRate(MAX_FPS);
+	if (exportSession.getStatus() == exporting) {
+		glsl.setRecording(true);
+		ofSetFrameRate(MAX_FPS);
+	}
 }
 
 //--------------------------------------------------------------
 void ofApp::endExport() {
-	vidRecorder.close();
-	exportingStatus = saving;
 	glsl.setRecording(false);
-	
-	ofSetFrameRate(glsl.getFrameRate());
+	ofSetFrameRate(glsl.getEngine().getFrameRate());
 }
 
 
 //--------------------------------------------------------------
-// events
+void ofApp::logStartup(const string &step) {
+	
+	uint64_t now = ofGetElapsedTimeMicros();
+	startupLog += (startupLog.empty() ? "" : ", ") + step + " " + ofToString((now - startupMark) / 1000.0f, 1) + "ms";
+	startupMark = now;
+}
 
-void ofApp::recordingComplete(ofxVideoRecorderOutputFileCompleteEventArgs& args) {
-	exportingStatus = stopped;
-	glsl.resetPlay();
+//--------------------------------------------------------------
+void ofApp::saveTrace(string path) {
+	
+	if (Trace::write(path)) {
+		ofLogNotice() << "Trace saved to " << path;
+	} else {
+		ofLogError() << "Failed to save trace to " << path;
+	}
 }
 
+//--------------------------------------------------------------
+// events
+
 void ofApp::shaderFileSelected(string &path) {
+	
+	// the export renders with the shader it started with
+	if (exportSession.getStatus() == exporting) {
+		return;
+	}
+	
 	glsl.loadShader(path);
 	
 	ofFile file(path);
@@ -143,6 +218,8 @@ void ofApp::frameRateUpdated(int &frameRate) {
 //--------------------------------------------------------------
 void ofApp::drawImGui(){
 	
+	TRACE_SCOPE("ofApp::drawImGui");
+	
 	gui.begin();
 	
 	static bool p_open = true;
@@ -154,28 +231,24 @@ void ofApp::drawImGui(){
 	{
 		ImGui::Separator();
 		
-		static stringstream ss;
-		ss.str("");
-		ss << "Time:" << setw(11) << glsl.getTimeText();
-		
 		ImGui::PushItemWidth(-1);
 		ImOf::PushMonospaceLargeFont();
-		ImGui::Text("%s", ss.str().c_str());
+		ImGui::Text("Time:%11s", glsl.getTimeText());
 		ImGui::PopFont();
 		ImGui::PopItemWidth();
 		
 		ImGui::Separator();
 		
+		static const vector<Codec> &codecs = ExportSession::getCodecs();
 		static const int codecNum = codecs.size();
 		
-		static const char** codecLabels = [](vector<Codec> &codecs) {
-			char** labels = new char*[codecs.size()];
-			for (int i = 0; i < codecs.size(); i++) {
-				labels[i] = new char[codecs[i].label.size() + 1];
-				strcpy(labels[i], codecs[i].label.c_str());
+		static const char** codecLabels = [] {
+			static vector<const char*> labels;
+			for (auto& codec : codecs) {
+				labels.push_back(codec.label.c_str());
 			}
-			return const_cast<const char**>(labels);
-		}(codecs);
+			return labels.data();
+		}();
 		
 		ImGui::PushItemWidth(80);
 		ImGui::Combo("", &selectedCodec, codecLabels, codecNum);
@@ -191,6 +264,98 @@ void ofApp::drawImGui(){
 			beginExport();
 		}
 		
+		RenderEngine &engine = glsl.getEngine();
+		
+		// predicted from sample frames and the source
+		if (exportSession.getStatus() == stopped && engine.isCompiled()) {
+			
+			const ShaderCost &cost = engine.getCost();
+			
+			if (estimate.isReady()) {
+				int eta = estimate.getEta(engine.getDuration());
+				ImGui::Text("%.1fms/F (max %.1f)  ETA %d:%02d:%02d", estimate.getFrameTime(), estimate.getMaxFrameTime(),
+							eta / 3600, eta / 60 % 60, eta % 60);
+			} else {
+				ImGui::TextDisabled("Estimating...");
+			}
+			
+			ImGui::TextDisabled("%.0f ALU, %.0f tex per pixel", cost.alu, cost.textures);
+			
+			ImGui::PushStyleColor(ImGuiCol_Text, ImVec4(1.0f, 0.8f, 0.3f, 1.0f));
+			for (auto& warning : cost.warnings) {
+				ImGui::TextWrapped("%s", warning.c_str());
+			}
+			ImGui::PopStyleColor();
+		}
+		
+		ImGui::PushItemWidth(-100);
+		ImGui::DragInt("Memory", &memoryBudget, 16.0f, 64, 16384, "%.0fMB");
+		ImGui::PopItemWidth();
+		
+		// downsampled copies written by the same export
+		ImGui::CheckboxFlags("1/2", &proxies, 1);
+		ImGui::SameLine();
+		ImGui::CheckboxFlags("1/4", &proxies, 2);
+		ImGui::SameLine();
+		ImGui::CheckboxFlags("1/8", &proxies, 4);
+		ImGui::SameLine();
+		ImGui::PushItemWidth(-1);
+		ImGui::Combo("##proxyFilter", &proxyFilter, "Box\0Lanczos\0");
+		ImGui::PopItemWidth();
+		
+		// rendered frames kept for the next export of the same frames
+		ImGui::Checkbox("Frame Cache", &useFrameCache);
+		ImGui::SameLine();
+		ImGui::PushItemWidth(70);
+		ImGui::DragInt("##frameCacheLimit", &frameCacheLimit, 64.0f, 256, 262144, "%.0fMB");
+		ImGui::PopItemWidth();
+		ImGui::SameLine();
+		if (ImGui::Button("Clear", ImVec2(-1, 0))) {
+			frameCache.clear();
+		}
+		
+		FrameQueue *queue = exportSession.getQueue();
+		
+		if (exportSession.getStatus() != stopped && queue) {
+			ImGui::Text("Queue %d/%d (%.0fMB)", queue->getDepth(), queue->getCapacity(), queue->getMemory() / (1024.0f * 1024.0f));
+			ImGui::Text("Stalled %.1fs", queue->getStallTime());
+			ImGui::Text("Duplicates %d", exportSession.getDuplicates());
+			
+			if (useFrameCache) {
+				ImGui::Text("Cached %d, %.0fMB", exportSession.getCacheHits(), frameCache.getSize() / (1024.0f * 1024.0f));
+			}
+			
+			if (!engine.getSpecializeLog().empty()) {
+				ImGui::TextWrapped("%s", engine.getSpecializeLog().c_str());
+			}
+		}
+		
+		// Chrome trace JSON, for chrome://tracing or ui.perfetto.dev
+		if (ImGui::Checkbox("Trace", &tracing)) {
+			if (tracing) {
+				Trace::clear();
+			}
+			Trace::setEnabled(tracing || (traceExport && exportSession.getStatus() != stopped));
+		}
+		ImGui::SameLine();
+		if (ImGui::Button("Save Trace")) {
+			ofFileDialogResult result = ofSystemSaveDialog("trace.json", "Save Trace");
+			if (result.bSuccess) {
+				saveTrace(result.getPath());
+			}
+		}
+		ImGui::SameLine();
+		ImGui::Checkbox("Per Export", &traceExport);
+		
+		// heap allocations of the last call, should stay 0 once settled
+		if (Allocations::isTracking()) {
+			for (auto counter : Allocations::counters()) {
+				ImGui::TextDisabled("%s", counter->name);
+				ImGui::SameLine(GUI_WIDTH - 60);
+				ImGui::Text("%d alloc", (int)counter->last);
+			}
+		}
+		
 		ImGui::Separator();
 		
 		for (auto& manager : managers) {
@@ -206,14 +371,20 @@ void ofApp::drawImGui(){
 //--------------------------------------------------------------
 void ofApp::exit() {
 	
-	vidRecorder.close();
+	exportSession.end();
 	
 	// save settings
 	ofxXmlSettings settings;
 	
 	settings.setValue("selectedCodec", selectedCodec);
 	settings.setValue("bitrate", bitrate);
+	settings.setValue("memoryBudget", memoryBudget);
+	settings.setValue("proxies", (int)proxies);
+	settings.setValue("proxyFilter", proxyFilter);
+	settings.setValue("frameCache", useFrameCache);
+	settings.setValue("frameCacheLimit", frameCacheLimit);
 	settings.setValue("exportName", exportName);
+	settings.setValue("traceExport", traceExport);
 	
 	for (auto& manager : managers) {
 		manager->saveSettings(settings);
@@ -291,7 +462,7 @@ void ofApp::dragEvent(ofDragInfo dragInfo){
 			shaderFile.setWatchDirectory(path);
 		} else if (file.isFile()) {
 			string ext = file.getExtension();
-			if (ext == "fs" || ext == "frag") {
+			if ((ext == "fs" || ext == "frag") && exportSession.getStatus() != exporting) {
 				glsl.loadShader(path);
 			}
 		}
@@ -4,24 +4,14 @@
 
 #include "ofxXmlSettings.h"
 #include "ofxImGui.h"
-#include "ofxVideoRecorder.h"
 
 #include "BaseManager.h"
 #include "GLSLManager.h"
 #include "ShaderFileManager.h"
-
-enum ExportingStatus {
-	stopped,
-	exporting,
-	saving
-};
-
-struct Codec {
-	string	label;
-	string	name;
-	string	extension;
-};
-
+#include "ExportSession.h"
+#include "ExportEstimate.h"
+#include "Trace.h"
+#include "Allocations.h"
 
 class ofApp : public ofBaseApp{
 
@@ -36,9 +26,11 @@ public:
 	void beginExport();
 	void endExport();
 	
+	void saveTrace(string path);
+	void logStartup(const string &step);
+	
 	// event
 	void frameRateUpdated(int &frameRate);
-	void recordingComplete(ofxVideoRecorderOutputFileCompleteEventArgs& args);
 	void shaderFileSelected(string &path);
 
 	void keyPressed(int key);
@@ -59,19 +51,28 @@ public:
 	GLSLManager				glsl;
 	ShaderFileManager		shaderFile;
 	
-	ofxVideoRecorder		vidRecorder;
-	ofPixels				pixels;
+	ExportSession			exportSession;
+	ExportEstimate			estimate;
+	FrameCache				frameCache;
 	
 	// params
 	
-	ExportingStatus			exportingStatus = stopped;
-	
-	int						currentFrame;
-	
-	vector<Codec>			codecs;
 	int						selectedCodec = 0;
 	int						bitrate = 800;
+	int						memoryBudget = 1024;	// MB for frames waiting to be written
+	unsigned int			proxies = 0;			// bit i for a proxy of 1/2^(i+1) size
+	int						proxyFilter = DOWNSAMPLE_LANCZOS;
+	bool					useFrameCache = false;
+	int						frameCacheLimit = 8192;	// MB of rendered frames kept on disk
 	string					exportName;
+	string					exportPath;
+	
+	// time to first frame, logged once the deferred shader is loaded
+	uint64_t				startupMark = 0;
+	string					startupLog;
+	int						framesDrawn = 0;
 	
+	bool					tracing = false;		// recording for Save Trace
+	bool					traceExport = false;	// a trace next to every export
 	
 };